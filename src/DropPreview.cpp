@@ -0,0 +1,93 @@
+#include "DropPreview.hpp"
+
+#include <hyprland/src/Compositor.hpp>
+#include <hyprland/src/helpers/Color.hpp>
+#include <hyprland/src/helpers/Monitor.hpp>
+#include <hyprland/src/managers/input/InputManager.hpp>
+#include <hyprland/src/render/OpenGL.hpp>
+
+#include "globals.hpp"
+
+// The window being moved with the mouse, if it was tiled when the drag started.
+static PHLWINDOW draggedTiledWindow() {
+	auto window = g_pInputManager->m_currentlyDraggedWindow.lock();
+	if (!window || g_pInputManager->m_dragMode != MBIND_MOVE || !window->m_draggingTiled)
+		return nullptr;
+
+	return window;
+}
+
+void Hy3DropPreview::tick() {
+	static const auto enabled = ConfigValue<Hyprlang::INT>("plugin:hy3:drag:preview");
+
+	if (!*enabled || !draggedTiledWindow()) {
+		this->clear();
+		return;
+	}
+
+	auto pos = g_pInputManager->getMouseCoordsInternal();
+	if (this->active && pos == this->last_pos) return;
+
+	this->active = true;
+	this->last_pos = pos;
+
+	std::optional<CBox> box;
+	auto monitor = g_pCompositor->getMonitorFromVector(pos);
+
+	if (monitor) {
+		auto* hy3 = hy3InstanceForWorkspace(monitor->m_activeWorkspace);
+		if (hy3 != nullptr) {
+			if (auto drop = hy3->resolveDrop(pos)) box = drop->preview;
+		}
+	}
+
+	if (box == this->box && monitor == this->monitor.lock()) return;
+
+	this->damage();
+	this->box = box;
+	this->monitor = monitor;
+	this->damage();
+}
+
+void Hy3DropPreview::clear() {
+	if (!this->active) return;
+
+	this->damage();
+	this->box.reset();
+	this->monitor.reset();
+	this->active = false;
+}
+
+void Hy3DropPreview::damage() {
+	if (!this->box) return;
+
+	auto box = *this->box;
+	box.expand(1);
+	g_pHyprRenderer->damageBox(box);
+}
+
+void Hy3DropPreview::addToPass() {
+	if (!this->box) return;
+	if (g_pHyprOpenGL->m_renderData.pMonitor != this->monitor) return;
+
+	g_pHyprRenderer->m_renderPass.add(makeUnique<Hy3DropPreviewPassElement>(this));
+}
+
+void Hy3DropPreview::render() {
+	static const auto window_rounding = ConfigValue<Hyprlang::INT>("decoration:rounding");
+	static const auto col_preview = ConfigValue<Hyprlang::INT>("plugin:hy3:drag:col.preview");
+
+	auto* monitor = g_pHyprOpenGL->m_renderData.pMonitor.get();
+	if (!this->box || monitor == nullptr) return;
+
+	auto box = this->box->copy().translate(-monitor->m_position).scale(monitor->m_scale).round();
+	if (box.width <= 0 || box.height <= 0) return;
+
+	g_pHyprOpenGL->renderRect(
+	    box,
+	    CHyprColor(*col_preview),
+	    {.round = static_cast<int>(*window_rounding * monitor->m_scale)}
+	);
+}
+
+void Hy3DropPreviewPassElement::draw(const CRegion& damage) { this->preview->render(); }
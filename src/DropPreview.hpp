@@ -0,0 +1,41 @@
+#pragma once
+
+#include <optional>
+
+#include <hyprland/src/helpers/math/Math.hpp>
+#include <hyprland/src/render/Renderer.hpp>
+
+// Outline of where a tiled window being dragged with the mouse will land.
+// Only damages and redraws the preview box, the layout is left alone until the drop.
+class Hy3DropPreview {
+public:
+	// Follow the pointer while a tiled window is dragged. Called every tick.
+	void tick();
+	// Add the preview to the render pass if it is on the monitor being rendered.
+	void addToPass();
+	void clear();
+
+	// Drawn by Hy3DropPreviewPassElement
+	void render();
+
+private:
+	std::optional<CBox> box;
+	PHLMONITORREF monitor;
+	Vector2D last_pos;
+	bool active = false;
+
+	void damage();
+};
+
+class Hy3DropPreviewPassElement: public IPassElement {
+public:
+	Hy3DropPreviewPassElement(Hy3DropPreview* preview): preview(preview) {}
+
+	const char* passName() override { return "Hy3DropPreviewPassElement"; }
+	void draw(const CRegion& damage) override;
+	bool needsLiveBlur() override { return false; }
+	bool needsPrecomputeBlur() override { return false; }
+
+private:
+	Hy3DropPreview* preview;
+};
@@ -27,6 +27,10 @@
 
 using namespace Desktop::View;
 
+static bool isWrapZone(Hy3DropZone zone) {
+	return zone == Hy3DropZone::WrapBefore || zone == Hy3DropZone::WrapAfter;
+}
+
 static CollapsePolicy nodeCollapsePolicy() {
 	static const auto node_collapse_policy =
 	    ConfigValue<Hyprlang::INT>("plugin:hy3:node_collapse_policy");
@@ -68,13 +72,18 @@ std::string operationWorkspaceForName(const std::string& workspace) {
 	return workspace;
 }
 
-Hy3Node* findTabBarAt(Hy3Node& node, Vector2D pos, Hy3Node** focused_node);
-
 Hy3Layout::Hy3Layout() {
 	g_hy3Instances.insert(this);
 
 	m_windowActiveListener = Event::bus()->m_events.window.active.listen(
 	    [this](PHLWINDOW window, Desktop::eFocusReason) {
+		    // focusing may raise the window
+		    g_zOrder.sync();
+
+		    if (window && window->m_isFloating && window->m_workspace == this->workspace()) {
+			    this->trackFloatingWindow(window);
+		    }
+
 		    if (!window) {
 					this->updateGroupBorderColors();
 			    return;
@@ -87,6 +96,8 @@ Hy3Layout::Hy3Layout() {
 					return;
 				}
 
+		    // focusing a window clears its urgency
+		    node->as<Hy3TargetNode>().refreshUrgent();
 		    this->onWindowFocusChange(window);
 	    }
 	);
@@ -108,9 +119,11 @@ Hy3Layout::Hy3Layout() {
 		    auto* node = this->getNodeFromWindow(window);
 		    if (!node) return;
 
+		    this->flushGeometry();
+
 		    Hy3Node* focus = nullptr;
 		    auto mouse_pos = g_pInputManager->getMouseCoordsInternal();
-		    auto* tab_node = findTabBarAt(*this->root, mouse_pos, &focus);
+		    auto* tab_node = this->findTabBarAt(*this->root, mouse_pos, &focus);
 		    if (!tab_node) return;
 
 		    while (focus->is_group() && !focus->as_group().group_focused
@@ -128,11 +141,10 @@ Hy3Layout::Hy3Layout() {
 
 Hy3Layout::~Hy3Layout() {
 	if (this->root) {
-		for (auto& window: this->root->windows()) {
-			window.setHidden(false);
-		}
+		this->root->forEachWindow([](CWindow& window) { window.setHidden(false); });
 	}
 	this->root.reset();
+	this->node_pool->release();
 
 	g_hy3Instances.erase(this);
 }
@@ -176,8 +188,9 @@ void Hy3Layout::newTarget(SP<Layout::ITarget> target) {
 		return;
 	}
 
-	auto node = Hy3Node::create(target);
+	auto node = Hy3Node::create(target, this->node_pool);
 
+	this->untrackFloatingWindow(window.get());
 	this->insertNode(std::move(node));
 }
 
@@ -213,19 +226,10 @@ void Hy3Layout::insertNode(UP<Hy3Node> node_up, std::optional<Vector2D> focalPoi
 	auto* rootNode = this->getWorkspaceRootGroup(ws.get());
 
 	if (rootNode != nullptr) {
-		if (focalPoint) {
-			auto window_at_point = g_pCompositor->vectorToWindowUnified(
-			    *focalPoint,
-			    RESERVED_EXTENTS | INPUT_EXTENTS
-			);
-
-			if (window_at_point && window_at_point->m_workspace == ws) {
-				opening_after = this->getNodeFromWindow(window_at_point.get());
-			}
-		}
+		if (focalPoint) opening_after = this->findDropNode(*focalPoint);
 
 		if (!opening_after) opening_after = &rootNode->getFocusedNode();
-		opening_after = &opening_after->getPlacementActor();
+		opening_after = &this->placementActorOf(*opening_after);
 
 		// opening_after->parent cannot be nullptr
 		if (opening_after == rootNode) {
@@ -245,17 +249,17 @@ void Hy3Layout::insertNode(UP<Hy3Node> node_up, std::optional<Vector2D> focalPoi
 			if (space) wa_box = space->workArea();
 		}
 
-		auto rootUp = makeUnique<Hy3RootNode>(this);
+		auto rootUp = UP<Hy3RootNode>(new (*this->node_pool) Hy3RootNode(this));
 		rootUp->self = WP<Hy3Node>(rootUp);
 		this->root = std::move(rootUp);
 
 		UP<Hy3Node> rootGroup;
 		if (*tab_first_window) {
-			rootGroup = Hy3Node::create(Hy3GroupLayout::Tabbed);
+			rootGroup = Hy3Node::create(Hy3GroupLayout::Tabbed, this->node_pool);
 		} else {
 			auto split_layout =
 					wa_box.height > wa_box.width ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH;
-			rootGroup = Hy3Node::create(split_layout);
+			rootGroup = Hy3Node::create(split_layout, this->node_pool);
 		}
 
 		opening_into = rootGroup.get();
@@ -268,6 +272,9 @@ void Hy3Layout::insertNode(UP<Hy3Node> node_up, std::optional<Vector2D> focalPoi
 		return;
 	}
 
+	std::optional<Hy3DropTarget> drop;
+	if (focalPoint && opening_after) drop = this->dropTargetFor(*opening_after, *focalPoint);
+
 	{
 		// clang-format off
 		static const auto at_enable = ConfigValue<Hyprlang::INT>("plugin:hy3:autotile:enable");
@@ -280,9 +287,11 @@ void Hy3Layout::insertNode(UP<Hy3Node> node_up, std::optional<Vector2D> focalPoi
 
 		auto& target_group = opening_into->as_group();
 		if (*at_enable && opening_after != nullptr && target_group.children.size() > 1
-		    && target_group.isSplit()
+		    && target_group.isSplit() && !(drop && isWrapZone(drop->zone))
 		    && this->shouldAutotileWorkspace(ws.get()))
 		{
+			this->flushGeometry();
+
 			auto is_horizontal = target_group.layout == Hy3GroupLayout::SplitH;
 			auto trigger = is_horizontal ? *at_trigger_width : *at_trigger_height;
 			auto target_size = is_horizontal ? opening_into->visualBox.w : opening_into->visualBox.h;
@@ -294,21 +303,28 @@ void Hy3Layout::insertNode(UP<Hy3Node> node_up, std::optional<Vector2D> focalPoi
 				    *at_ephemeral ? GroupEphemeralityOption::Ephemeral : GroupEphemeralityOption::Standard
 				);
 				opening_into = opening_after->parent.get();
+
+				// the node was just split, don't split it again. Only mouse drops carry
+				// a drop target, keyboard opens keep going after the focused node.
+				if (drop) {
+					drop = this->dropTargetFor(*opening_after, *focalPoint);
+					if (drop->zone == Hy3DropZone::WrapBefore) drop->zone = Hy3DropZone::Before;
+					else if (drop->zone == Hy3DropZone::WrapAfter) drop->zone = Hy3DropZone::After;
+				}
 			}
 		}
 	}
 
 	// For mouse drops, determine if we should insert before or after the target node
-	if (focalPoint && opening_after) {
-		auto& parentGroup = opening_into->as_group();
-		bool insert_before = false;
-
-		if (parentGroup.layout == Hy3GroupLayout::SplitH) {
-			insert_before = focalPoint->x < opening_after->visualBox.x + opening_after->visualBox.w * 0.5;
-		} else if (parentGroup.layout == Hy3GroupLayout::SplitV) {
-			insert_before = focalPoint->y < opening_after->visualBox.y + opening_after->visualBox.h * 0.5;
+	if (drop) {
+		if (isWrapZone(drop->zone)) {
+			opening_after->wrap(drop->wrap_layout, GroupEphemeralityOption::Standard);
+			opening_into = opening_after->parent.get();
 		}
 
+		auto& parentGroup = opening_into->as_group();
+		auto insert_before = drop->zone == Hy3DropZone::Before || drop->zone == Hy3DropZone::WrapBefore;
+
 		if (insert_before) {
 			auto iter = parentGroup.findChild(*opening_after);
 			if (iter != parentGroup.children.begin()) {
@@ -343,6 +359,7 @@ void Hy3Layout::insertNode(UP<Hy3Node> node_up, std::optional<Vector2D> focalPoi
 	node->markFocused();
 	this->recalcGeometry();
 	this->updateGroupBorderColors();
+	this->autoNormalize();
 }
 
 void Hy3Layout::movedTarget(SP<Layout::ITarget> target, std::optional<Vector2D> focalPoint) {
@@ -351,7 +368,104 @@ void Hy3Layout::movedTarget(SP<Layout::ITarget> target, std::optional<Vector2D>
 	// Use mouse position as focal point when none provided (e.g. DnD drop)
 	if (!focalPoint) focalPoint = g_pInputManager->getMouseCoordsInternal();
 
-	this->insertNode(Hy3Node::create(target), focalPoint);
+	this->insertNode(Hy3Node::create(target, this->node_pool), focalPoint);
+}
+
+Hy3Node* Hy3Layout::findDropNode(Vector2D pos) {
+	// clang-format off
+	static const auto p_gaps_in = ConfigValue<Hyprlang::CUSTOMTYPE, CCssGapData>("general:gaps_in");
+	static const auto p_gaps_out = ConfigValue<Hyprlang::CUSTOMTYPE, CCssGapData>("general:gaps_out");
+	static const auto border_size = ConfigValue<Hyprlang::INT>("general:border_size");
+	static const auto grab_area = ConfigValue<Hyprlang::INT>("general:extend_border_grab_area");
+	// clang-format on
+
+	this->flushGeometry();
+
+	auto largest = [](const CCssGapData& gaps) {
+		return std::max({gaps.m_top, gaps.m_right, gaps.m_bottom, gaps.m_left});
+	};
+
+	// Boxes are window contents. Drops on borders, input extents and the gaps
+	// around a window go to the nearest window, as they did when hyprland
+	// resolved the window under the cursor.
+	auto margin = largest(*p_gaps_in) + largest(*p_gaps_out) + *border_size + *grab_area;
+	auto area = CBox(pos.x - margin, pos.y - margin, margin * 2 + 1, margin * 2 + 1);
+
+	Hy3Node* found = nullptr;
+	auto found_distance = 0.0;
+
+	this->spatial_index.query(area, [&](Hy3Node* node, const CBox& box) {
+		auto dx = std::max({box.x - pos.x, 0.0, pos.x - (box.x + box.w)});
+		auto dy = std::max({box.y - pos.y, 0.0, pos.y - (box.y + box.h)});
+		auto distance = dx * dx + dy * dy;
+
+		if (found == nullptr || distance < found_distance) {
+			found = node;
+			found_distance = distance;
+		}
+	});
+
+	if (found == nullptr) return nullptr;
+	return &this->placementActorOf(*found);
+}
+
+Hy3DropTarget Hy3Layout::dropTargetFor(Hy3Node& node, Vector2D pos) {
+	static const auto wrap = ConfigValue<Hyprlang::INT>("plugin:hy3:drag:wrap");
+
+	// a lone root group gets wrapped in a horizontal split before anything is inserted
+	auto layout = node.parent ? node.parent->as_group().layout : Hy3GroupLayout::SplitH;
+	if (layout == Hy3GroupLayout::Root) layout = Hy3GroupLayout::SplitH;
+
+	auto& box = node.visualBox;
+	auto u = box.w > 0 ? (pos.x - box.x) / box.w : 0.5;
+	auto v = box.h > 0 ? (pos.y - box.y) / box.h : 0.5;
+
+	auto half = [&](bool horizontal, bool before) {
+		if (horizontal) return CBox(before ? box.x : box.x + box.w / 2, box.y, box.w / 2, box.h);
+		else return CBox(box.x, before ? box.y : box.y + box.h / 2, box.w, box.h / 2);
+	};
+
+	auto target = Hy3DropTarget {.node = &node, .zone = Hy3DropZone::After, .wrap_layout = layout};
+
+	auto centered = std::abs(u - 0.5) < 0.25 && std::abs(v - 0.5) < 0.25;
+	if (*wrap && !(layout == Hy3GroupLayout::Tabbed && centered)) {
+		// the nearest edge picks the side. edges across the group's axis split the
+		// target node instead of inserting next to it.
+		auto horizontal = std::min(u, 1 - u) < std::min(v, 1 - v);
+		auto before = horizontal ? u < 0.5 : v < 0.5;
+		auto edge_layout = horizontal ? Hy3GroupLayout::SplitH : Hy3GroupLayout::SplitV;
+
+		if (edge_layout == layout) {
+			target.zone = before ? Hy3DropZone::Before : Hy3DropZone::After;
+		} else {
+			target.zone = before ? Hy3DropZone::WrapBefore : Hy3DropZone::WrapAfter;
+			target.wrap_layout = edge_layout;
+		}
+
+		target.preview = half(horizontal, before);
+		return target;
+	}
+
+	switch (layout) {
+	case Hy3GroupLayout::SplitH:
+		if (u < 0.5) target.zone = Hy3DropZone::Before;
+		target.preview = half(true, u < 0.5);
+		break;
+	case Hy3GroupLayout::SplitV:
+		if (v < 0.5) target.zone = Hy3DropZone::Before;
+		target.preview = half(false, v < 0.5);
+		break;
+	default: target.preview = box; break;
+	}
+
+	return target;
+}
+
+std::optional<Hy3DropTarget> Hy3Layout::resolveDrop(Vector2D pos) {
+	auto* node = this->findDropNode(pos);
+	if (node == nullptr) return std::nullopt;
+
+	return this->dropTargetFor(*node, pos);
 }
 
 void Hy3Layout::removeTarget(SP<Layout::ITarget> target) {
@@ -377,6 +491,9 @@ void Hy3Layout::removeTarget(SP<Layout::ITarget> target) {
 	parent_node->extractAndMerge(*node, nullptr, nodeCollapsePolicy());
 	this->recalcGeometry();
 
+	// the window may have been made floating, lookups skip it otherwise
+	this->trackFloatingWindow(window);
+
 	this->updateGroupBorderColors();
 }
 
@@ -398,24 +515,134 @@ void Hy3Layout::onWindowFocusChange(PHLWINDOW window) {
 }
 
 void Hy3Layout::updateGroupBorderColors() {
-	if (!this->root) return;
+	if (this->pending.depth > 0) {
+		this->pending.borders = true;
+		return;
+	}
+
+	this->applyGroupBorderColors();
+}
+
+void Hy3Layout::applyGroupBorderColors() {
 	static auto active_color = CConfigValue<Hyprlang::CUSTOMTYPE>("general:col.active_border");
 
-	for (auto& w: this->root->windows()) {
-		if (this->shouldRenderSelected(&w)) {
-			auto* gradient = static_cast<CGradientValueData*>((active_color.ptr())->getData());
-			w.m_ruleApplicator->inactiveBorderColor().set(*gradient, Desktop::Types::PRIORITY_LAYOUT);
-		} else {
-			w.m_ruleApplicator->inactiveBorderColor().unset(Desktop::Types::PRIORITY_LAYOUT);
-		}
+	// Windows get the selection border when a node is focused with no window having
+	// input focus, e.g. after focusing a whole group.
+	std::unordered_map<const CWindow*, PHLWINDOWREF> selected;
+
+	auto* root_group = this->getWorkspaceRootGroup(nullptr);
+	if (root_group != nullptr && root_group->as_group().focused_child != nullptr
+	    && !Desktop::focusState()->window())
+	{
+		root_group->getFocusedNode().forEachWindow([&](CWindow& w) {
+			selected.emplace(&w, w.m_self);
+		});
+	}
+
+	// only windows entering or leaving the selection need their override touched
+	for (auto& [ptr, ref]: this->selected_windows) {
+		if (selected.contains(ptr)) continue;
+
+		auto window = ref.lock();
+		if (!window) continue;
+
+		// the window may have moved to another layout that selects it
+		auto selected_elsewhere = std::ranges::any_of(g_hy3Instances, [&](Hy3Layout* hy3) {
+			return hy3 != this && hy3->selected_windows.contains(ptr);
+		});
+
+		if (selected_elsewhere) continue;
 
-		w.updateDecorationValues();
+		window->m_ruleApplicator->inactiveBorderColor().unset(Desktop::Types::PRIORITY_LAYOUT);
+		window->updateDecorationValues();
 	}
+
+	for (auto& [ptr, ref]: selected) {
+		if (this->selected_windows.contains(ptr)) continue;
+
+		auto* gradient = static_cast<CGradientValueData*>((active_color.ptr())->getData());
+		auto window = ref.lock();
+		window->m_ruleApplicator->inactiveBorderColor().set(*gradient, Desktop::Types::PRIORITY_LAYOUT);
+		window->updateDecorationValues();
+	}
+
+	this->selected_windows = std::move(selected);
+}
+
+void Hy3Layout::recalculate() { this->recalcGeometry(false, true); }
+
+void Hy3Layout::recalcGeometry(bool no_animation, bool force) {
+	static const auto deferred_layout = ConfigValue<Hyprlang::INT>("plugin:hy3:deferred_layout");
+
+	this->pending.recalc = true;
+	this->pending.no_animation |= no_animation;
+	this->pending.force |= force;
+
+	// forced recalcs come from hyprland, which expects the result immediately
+	if (this->pending.depth > 0 || (*deferred_layout && !force)) return;
+
+	this->flushGeometry();
 }
 
-void Hy3Layout::recalculate() { this->recalcGeometry(); }
+void Hy3Layout::flushGeometry() {
+	if (!this->pending.recalc) return;
+	this->pending.recalc = false;
+
+	this->applyGeometry(
+	    std::exchange(this->pending.no_animation, false),
+	    std::exchange(this->pending.force, false)
+	);
+}
+
+Hy3Layout::Transaction::Transaction(Hy3Layout* layout): layout(layout) {
+	if (this->layout) this->layout->pending.depth++;
+}
 
-void Hy3Layout::recalcGeometry(bool no_animation) {
+Hy3Layout::Transaction::~Transaction() {
+	// the layout may have been destroyed by the wrapped operation
+	if (!this->layout || !g_hy3Instances.contains(this->layout)) return;
+	if (--this->layout->pending.depth == 0) this->layout->flushPending();
+}
+
+bool Hy3Layout::deferTabBarUpdate(Hy3GroupNode& group, bool no_animation) {
+	if (this->pending.depth == 0) return false;
+
+	group.tab_bar_no_animation |= no_animation;
+	if (!group.tab_bar_queued) {
+		group.tab_bar_queued = true;
+		this->pending.tab_bars.push_back(group.self);
+	}
+
+	return true;
+}
+
+void Hy3Layout::flushPending() {
+	auto& pending = this->pending;
+
+	// Geometry first, keeping the transaction open so tab bar updates made by the
+	// recalc join the queue, then tab bars, then borders, which read both.
+	auto depth = std::exchange(pending.depth, 1);
+	this->flushGeometry();
+	pending.depth = 0;
+
+	auto tab_bars = std::move(pending.tab_bars);
+	pending.tab_bars.clear();
+
+	for (auto& weak: tab_bars) {
+		auto* node = weak.get();
+		if (node == nullptr) continue;
+
+		auto& group = node->as_group();
+		group.tab_bar_queued = false;
+		node->updateTabBar(std::exchange(group.tab_bar_no_animation, false));
+	}
+
+	if (std::exchange(pending.borders, false)) this->applyGroupBorderColors();
+
+	pending.depth = depth;
+}
+
+void Hy3Layout::applyGeometry(bool no_animation, bool force) {
 	auto algo = m_parent.lock();
 	if (!algo) return;
 	auto space = algo->space();
@@ -429,13 +656,37 @@ void Hy3Layout::recalcGeometry(bool no_animation) {
 	auto wa = space->workArea();
 
 	if (this->root) {
+	auto ctx = Hy3RecalcContext {.no_animation = no_animation, .force = force, .layout = this};
+
 	this->root->visualBox = wa;
 	this->root->recalcSizePosRecursive(CBox{
 	    wa.x - ma.x,
 	    wa.y - ma.y,
 	    (ma.x + ma.w) - (wa.x + wa.w),
 	    (ma.y + ma.h) - (wa.y + wa.h),
-	}, no_animation);
+	}, ctx);
+
+	this->tab_bar_index.valid = false;
+	this->recalc_stats.passes++;
+	this->recalc_stats.last_visited = ctx.visited;
+	this->recalc_stats.total_visited += ctx.visited;
+	hy3_log(TRACE, "recalc visited {} nodes{}", ctx.visited, force ? " (forced)" : "");
+
+	this->updateSingleWindow(workspace);
+	}
+}
+
+void Hy3Layout::updateSingleWindow(const PHLWORKSPACE& workspace) {
+	auto* node = this->getWorkspaceRootGroup(workspace.get());
+	auto single = node != nullptr && node->is_group() && node->counts.windows == 1
+	           && node->as_group().children.front()->is_target();
+
+	if (single == this->single_window) return;
+	this->single_window = single;
+
+	// includes bars still animating out, which are what no_gaps_when_only hides
+	for (auto& tab_group: g_tabGroups) {
+		if (tab_group && tab_group->workspace == workspace) tab_group->single_window = single;
 	}
 }
 
@@ -456,7 +707,8 @@ void Hy3Layout::resizeTarget(const Vector2D& delta, SP<Layout::ITarget> target,
 	auto window = node->as_window();
 	if (!valid(window)) return;
 
-	node = &node->getExpandActor();
+	node = &this->expandActorOf(*node);
+	this->flushGeometry();
 
 	// Compare against work area since node position/size is the visible area
 	CBox workArea = {};
@@ -544,15 +796,15 @@ std::expected<void, std::string> Hy3Layout::layoutMsg(const std::string_view& sv
 		auto* node = this->getNodeFromWindow(window.get());
 		if (node != nullptr) {
 			node->assertNotRoot();
-			auto& layout = node->parent->as_group().layout;
+			auto& group = node->parent->as_group();
 
-			switch (layout) {
+			switch (group.layout) {
 			case Hy3GroupLayout::SplitH:
-				layout = Hy3GroupLayout::SplitV;
+				group.setLayout(Hy3GroupLayout::SplitV);
 				this->recalcGeometry();
 				break;
 			case Hy3GroupLayout::SplitV:
-				layout = Hy3GroupLayout::SplitH;
+				group.setLayout(Hy3GroupLayout::SplitH);
 				this->recalcGeometry();
 				break;
 			case Hy3GroupLayout::Root: break;
@@ -589,18 +841,55 @@ PHLWINDOW Hy3Layout::findTiledWindowCandidate(const CWindow* from) {
 	return PHLWINDOW();
 }
 
+static bool isFloatingCandidate(const PHLWINDOW& w, const CWindow* from) {
+	return w && w->m_isMapped && !w->isHidden() && w->m_isFloating && !w->isX11OverrideRedirect()
+	    && w->m_workspace == from->m_workspace && !w->m_X11ShouldntFocus
+	    && !w->m_ruleApplicator->noFocus().valueOrDefault() && w.get() != from;
+}
+
+void Hy3Layout::trackFloatingWindow(const PHLWINDOW& window) {
+	auto tracked = std::ranges::any_of(this->floating_windows, [&](const PHLWINDOWREF& ref) {
+		return ref.get() == window.get();
+	});
+
+	if (!tracked) this->floating_windows.emplace_back(window);
+}
+
+void Hy3Layout::untrackFloatingWindow(const CWindow* window) {
+	std::erase_if(this->floating_windows, [&](const PHLWINDOWREF& ref) {
+		return ref.expired() || ref.get() == window;
+	});
+}
+
 PHLWINDOW Hy3Layout::findFloatingWindowCandidate(const CWindow* from) {
-	// return the first floating window on the same workspace that has not asked not to be focused
-	for (auto& w: g_pCompositor->m_windows | std::views::reverse) {
-		if (w->m_isMapped && !w->isHidden() && w->m_isFloating && !w->isX11OverrideRedirect()
-		    && w->m_workspace == from->m_workspace && !w->m_X11ShouldntFocus
-		    && !w->m_ruleApplicator->noFocus().valueOrDefault() && w.get() != from)
-		{
-			return w;
+	// windows that were floating here before this layout existed
+	if (!this->floating_seeded) {
+		this->floating_seeded = true;
+		auto workspace = this->workspace();
+
+		for (auto& w: g_pCompositor->m_windows) {
+			if (w->m_isFloating && w->m_workspace == workspace) this->trackFloatingWindow(w);
 		}
 	}
 
-	return nullptr;
+	std::erase_if(this->floating_windows, [](const PHLWINDOWREF& ref) { return ref.expired(); });
+
+	// return the topmost floating window on the same workspace that has not asked not to be focused
+	PHLWINDOW result;
+	auto result_rank = Hy3ZOrder::UNKNOWN;
+
+	for (auto& ref: this->floating_windows) {
+		auto w = ref.lock();
+		if (!isFloatingCandidate(w, from)) continue;
+
+		auto rank = g_zOrder.rank(w.get());
+		if (!result || rank > result_rank) {
+			result = w;
+			result_rank = rank;
+		}
+	}
+
+	return result;
 }
 
 void Hy3Layout::makeGroupOnWorkspace(
@@ -611,7 +900,7 @@ void Hy3Layout::makeGroupOnWorkspace(
 ) {
 	auto* node = this->getWorkspaceFocusedNode(workspace);
 	if (node == nullptr) return;
-	node = &node->getPlacementActor();
+	node = &this->placementActorOf(*node);
 
 	if (toggle) {
 		auto* parent = node->parent.get();
@@ -638,14 +927,14 @@ void Hy3Layout::makeOppositeGroupOnWorkspace(
 ) {
 	auto* node = this->getWorkspaceFocusedNode(workspace);
 	if (node == nullptr) return;
-	node = &node->getPlacementActor();
+	node = &this->placementActorOf(*node);
 	this->makeOppositeGroupOn(*node, ephemeral);
 }
 
 void Hy3Layout::changeGroupOnWorkspace(const CWorkspace* workspace, Hy3GroupLayout layout) {
 	auto* node = this->getWorkspaceFocusedNode(workspace);
 	if (node == nullptr) return;
-	node = &node->getPlacementActor();
+	node = &this->placementActorOf(*node);
 
 	this->changeGroupOn(*node, layout);
 }
@@ -653,7 +942,7 @@ void Hy3Layout::changeGroupOnWorkspace(const CWorkspace* workspace, Hy3GroupLayo
 void Hy3Layout::untabGroupOnWorkspace(const CWorkspace* workspace) {
 	auto* node = this->getWorkspaceFocusedNode(workspace);
 	if (node == nullptr) return;
-	node = &node->getPlacementActor();
+	node = &this->placementActorOf(*node);
 
 	this->untabGroupOn(*node);
 }
@@ -661,7 +950,7 @@ void Hy3Layout::untabGroupOnWorkspace(const CWorkspace* workspace) {
 void Hy3Layout::toggleTabGroupOnWorkspace(const CWorkspace* workspace) {
 	auto* node = this->getWorkspaceFocusedNode(workspace);
 	if (node == nullptr) return;
-	node = &node->getPlacementActor();
+	node = &this->placementActorOf(*node);
 
 	this->toggleTabGroupOn(*node);
 }
@@ -669,7 +958,7 @@ void Hy3Layout::toggleTabGroupOnWorkspace(const CWorkspace* workspace) {
 void Hy3Layout::changeGroupToOppositeOnWorkspace(const CWorkspace* workspace) {
 	auto* node = this->getWorkspaceFocusedNode(workspace);
 	if (node == nullptr) return;
-	node = &node->getPlacementActor();
+	node = &this->placementActorOf(*node);
 
 	this->changeGroupToOppositeOn(*node);
 }
@@ -677,7 +966,7 @@ void Hy3Layout::changeGroupToOppositeOnWorkspace(const CWorkspace* workspace) {
 void Hy3Layout::changeGroupEphemeralityOnWorkspace(const CWorkspace* workspace, bool ephemeral) {
 	auto* node = this->getWorkspaceFocusedNode(workspace);
 	if (node == nullptr) return;
-	node = &node->getPlacementActor();
+	node = &this->placementActorOf(*node);
 
 	this->changeGroupEphemeralityOn(*node, ephemeral);
 }
@@ -694,6 +983,8 @@ void Hy3Layout::makeGroupOn(
 	node.wrap(layout, ephemeral);
 	node.parent->collapseParents(CollapsePolicy::InvalidOnly);
 	this->recalcGeometry();
+	// the group the user just made would otherwise be flattened right away
+	this->autoNormalize(node.parent.get());
 }
 
 void Hy3Layout::makeOppositeGroupOn(Hy3Node& node, GroupEphemeralityOption ephemeral) {
@@ -767,11 +1058,19 @@ void Hy3Layout::shiftWindow(
     const CWorkspace* workspace,
     ShiftDirection direction,
     bool once,
-    bool visible
+    bool visible,
+    bool geometric
 ) {
 	auto* node = this->getWorkspaceFocusedNode(workspace);
 	if (node == nullptr) return;
 
+	if (geometric) {
+		if (auto* target = this->findGeometricNeighbor(*node, direction)) {
+			this->moveNodeBeside(*node, *target, direction);
+			return;
+		}
+	}
+
 	this->shiftNode(*node, direction, once, visible);
 }
 
@@ -779,7 +1078,8 @@ void Hy3Layout::shiftFocus(
     const CWorkspace* workspace,
     ShiftDirection direction,
     bool visible,
-    bool warp
+    bool warp,
+    bool geometric
 ) {
 	auto current_window = Desktop::focusState()->window();
 
@@ -807,7 +1107,18 @@ void Hy3Layout::shiftFocus(
 		return;
 	}
 
-	auto* target = this->shiftOrGetFocus(*node, direction, false, false, visible);
+	Hy3Node* target;
+
+	if (geometric) {
+		target = this->findGeometricNeighbor(*node, direction);
+
+		if (target == nullptr) {
+			this->focusMonitor(direction);
+			return;
+		}
+	} else {
+		target = this->shiftOrGetFocus(*node, direction, false, false, visible);
+	}
 
 	if (target != nullptr) {
 		if (warp) {
@@ -896,6 +1207,7 @@ void Hy3Layout::warpCursor() {
 		    this->getWorkspaceFocusedNode(Desktop::focusState()->monitor()->m_activeWorkspace.get());
 
 		if (node != nullptr) {
+			this->flushGeometry();
 			Hy3Layout::warpCursorWithFocus(node->visualBox.pos() + node->visualBox.size() / 2);
 		}
 	}
@@ -965,12 +1277,13 @@ void Hy3Layout::moveNodeToWorkspace(
 		auto node_up = parent_node->extractAndMerge(*node, nullptr);
 		auto* destHy3 = hy3InstanceForWorkspace(workspace);
 		auto* destLayout = destHy3 ? destHy3 : this;
+		auto dest_transaction = Transaction(destLayout);
 
 		g_suppressInsert = true;
 
-		for (auto& window: node->windows()) {
+		node->forEachWindow([&](CWindow& window) {
 			window.layoutTarget()->assignToSpace(workspace->m_space);
-		}
+		});
 
 		g_suppressInsert = false;
 
@@ -995,6 +1308,8 @@ void Hy3Layout::moveNodeToWorkspace(
 		monitor->changeWorkspace(workspace);
 
 		node->layout()->recalcGeometry();
+		// warping reads the window's committed position
+		node->layout()->flushPending();
 		node->focus(warp, Desktop::FOCUS_REASON_KEYBIND);
 	}
 }
@@ -1049,61 +1364,131 @@ bottom:
 	return;
 }
 
-Hy3Node* findTabBarAt(Hy3Node& node, Vector2D pos, Hy3Node** focused_node) {
+static void collectTabBars(
+    Hy3Node& node,
+    double inset,
+    std::vector<Hy3TabBarHitArea>& areas,
+    bool& settled
+) {
+	if (!node.is_group() || node.hidden) return;
+	auto& group = node.as_group();
+
+	if (!group.isTab() || !group.tab_bar) {
+		for (auto& child: group.children) {
+			collectTabBars(*child, inset, areas, settled);
+		}
+
+		return;
+	}
+
+	auto& tab_bar = *group.tab_bar.get();
+	if (tab_bar.pos->isBeingAnimated() || tab_bar.size->isBeingAnimated()) settled = false;
+
+	// note: tab bar clicks ignore animations
+	auto& box = node.visualBox;
+	auto area = Hy3TabBarHitArea {
+	    .group = &node,
+	    .rect = CBox(box.x, node.logicalBox.y, box.w, box.y + inset - node.logicalBox.y),
+	    .order = areas.size(),
+	};
+
+	auto width = tab_bar.size->value().x;
+	auto x = tab_bar.pos->value().x;
+	auto child_iter = group.children.begin();
+
+	for (auto& tab: tab_bar.bar.entries) {
+		if (child_iter == group.children.end()) break;
+		if (tab.offset->isBeingAnimated() || tab.width->isBeingAnimated()) settled = false;
+
+		area.starts.push_back(x + tab.offset->value() * width);
+		area.ends.push_back(x + (tab.offset->value() + tab.width->value()) * width);
+		area.tabs.push_back(child_iter->get());
+		child_iter = std::next(child_iter);
+	}
+
+	areas.push_back(std::move(area));
+
+	if (group.focused_child != nullptr) collectTabBars(*group.focused_child, inset, areas, settled);
+}
+
+void Hy3Layout::rebuildTabBarIndex() {
 	// clang-format off
 	static const auto p_gaps_in = ConfigValue<Hyprlang::CUSTOMTYPE, CCssGapData>("general:gaps_in");
 	static const auto tab_bar_height = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:height");
 	static const auto tab_bar_padding = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:padding");
 	// clang-format on
 
-	auto workspace_rule = g_pConfigManager->getWorkspaceRuleFor(node.layout()->workspace());
-	auto gaps_in = workspace_rule.gapsIn.value_or(*p_gaps_in);
+	auto& index = this->tab_bar_index;
+	index.areas.clear();
+	index.grid.clear();
+	index.valid = true;
 
+	if (!this->root) return;
+
+	auto workspace_rule = g_pConfigManager->getWorkspaceRuleFor(this->workspace());
+	auto gaps_in = workspace_rule.gapsIn.value_or(*p_gaps_in);
 	auto inset = *tab_bar_height + *tab_bar_padding + gaps_in.m_top;
 
-	if (node.is_group()) {
-		if (node.hidden) return nullptr;
-		// note: tab bar clicks ignore animations
-		if (node.visualBox.x > pos.x || node.logicalBox.y > pos.y || node.visualBox.x + node.visualBox.w < pos.x
-		    || node.visualBox.y + node.visualBox.h < pos.y)
-			return nullptr;
-
-		auto& group = node.as_group();
-
-		if (group.isTab() && group.tab_bar) {
-			if (pos.y < node.visualBox.y + inset) {
-				auto& children = group.children;
-				auto& tab_bar = *group.tab_bar.get();
-
-				auto size = tab_bar.size->value();
-				auto x = pos.x - tab_bar.pos->value().x;
-				auto child_iter = children.begin();
-
-				for (auto& tab: tab_bar.bar.entries) {
-					if (child_iter == children.end()) break;
-
-					if (x > tab.offset->value() * size.x
-					    && x < (tab.offset->value() + tab.width->value()) * size.x)
-					{
-						*focused_node = child_iter->get();
-						return &node;
-					}
+	auto settled = true;
+	collectTabBars(*this->root, inset, index.areas, settled);
 
-					child_iter = std::next(child_iter);
-				}
-			}
+	// the grid holds pointers into `areas`, so fill it once `areas` is complete
+	for (auto& area: index.areas) {
+		index.grid.update(&area, area.rect);
+	}
 
-			if (group.focused_child != nullptr) {
-				return findTabBarAt(*group.focused_child, pos, focused_node);
-			}
-		} else {
-			for (auto& child: group.children) {
-				if (findTabBarAt(*child, pos, focused_node)) return child.get();
-			}
+	// positions are mid-animation, look them up again next time
+	if (!settled) index.valid = false;
+}
+
+Hy3Node* Hy3Layout::findTabBarAt(Hy3Node& from, Vector2D pos, Hy3Node** focused_node) {
+	this->flushGeometry();
+
+	auto& index = this->tab_bar_index;
+	auto tree_changed = this->root && (this->root->dirty || this->root->child_dirty);
+	if (!index.valid || tree_changed) this->rebuildTabBarIndex();
+
+	const Hy3TabBarHitArea* hit = nullptr;
+	Hy3Node* hit_tab = nullptr;
+
+	index.grid.query(CBox(pos.x, pos.y, 1, 1), [&](Hy3TabBarHitArea* area, const CBox& rect) {
+		if (hit != nullptr && hit->order < area->order) return;
+
+		if (pos.x < rect.x || pos.x > rect.x + rect.w || pos.y < rect.y || pos.y >= rect.y + rect.h)
+			return;
+
+		// last tab starting at or before pos.x
+		auto it = std::upper_bound(area->starts.begin(), area->starts.end(), pos.x);
+		if (it == area->starts.begin()) return;
+		auto i = static_cast<size_t>(it - area->starts.begin() - 1);
+
+		if (pos.x > area->starts[i] && pos.x < area->ends[i]) {
+			hit = area;
+			hit_tab = area->tabs[i];
 		}
+	});
+
+	if (hit == nullptr) return nullptr;
+
+	// path from the hit group up to `from`, which must contain it
+	std::vector<Hy3Node*> path;
+	for (auto* node = hit->group; node != &from; node = node->parent.get()) {
+		if (node == nullptr) return nullptr;
+		path.push_back(node);
 	}
 
-	return nullptr;
+	*focused_node = hit_tab;
+
+	// Walking down from `from`, tab groups pass the hit through and any other
+	// group reports its child containing it.
+	auto* node = &from;
+	for (auto it = path.rbegin(); it != path.rend(); it++) {
+		auto& group = node->as_group();
+		if (!group.isTab() || !group.tab_bar) return *it;
+		node = *it;
+	}
+
+	return node;
 }
 
 void Hy3Layout::focusTab(
@@ -1133,7 +1518,7 @@ void Hy3Layout::focusTab(
 		if (!window || window->m_isFloating) return;
 
 		auto mouse_pos = g_pInputManager->getMouseCoordsInternal();
-		tab_node = findTabBarAt(*node, mouse_pos, &tab_focused_node);
+		tab_node = this->findTabBarAt(*node, mouse_pos, &tab_focused_node);
 		if (tab_node != nullptr) goto hastab;
 
 		if (target == TabFocus::MouseLocation || mouse == TabFocusMousePriority::Require) return;
@@ -1226,7 +1611,13 @@ void Hy3Layout::killFocusedNode(const CWorkspace* workspace) {
 		if (node == nullptr) return;
 
 		std::vector<PHLWINDOW> windows;
-		for (auto& w: node->windows()) windows.push_back(w.m_self.lock());
+		node->forEachNode([&](Hy3Node& child) {
+			if (!child.is_target()) return;
+
+			// keep recalcs hiding the window again if the client ignores the close
+			child.as<Hy3TargetNode>().committed.hidden = false;
+			windows.push_back(child.as_window());
+		});
 
 		for (auto& window: windows) {
 			window->setHidden(false);
@@ -1248,12 +1639,16 @@ void Hy3Layout::expand(
 	case ExpandOption::Expand: {
 		node->assertNotRoot();
 
-		if (node->is_group() && !node->as_group().group_focused)
+		if (node->is_group() && !node->as_group().group_focused) {
 			node->as_group().expand_focused = ExpandFocusType::Stack;
+			node->markDirty();
+		}
 
 		auto& group = node->parent->as_group();
 		group.focused_child = node;
 		group.expand_focused = ExpandFocusType::Latch;
+		group.markDirty();
+		this->invalidateFocusCache();
 
 		this->recalcGeometry();
 
@@ -1270,8 +1665,13 @@ void Hy3Layout::expand(
 			auto& group = node->as_group();
 
 			group.expand_focused = ExpandFocusType::NotExpanded;
-			if (group.focused_child->is_group())
+			group.markDirty();
+			if (group.focused_child->is_group()) {
 				group.focused_child->as_group().expand_focused = ExpandFocusType::Latch;
+				group.focused_child->markDirty();
+			}
+
+			this->invalidateFocusCache();
 
 			this->recalcGeometry();
 		}
@@ -1305,6 +1705,8 @@ void Hy3Layout::setTabLock(const CWorkspace* workspace, TabLockMode mode) {
 		case TabLockMode::Toggle: group.locked = !group.locked; break;
 		}
 
+		this->invalidateFocusCache();
+
 		node.parent->updateTabBar();
 		return;
 	}
@@ -1312,6 +1714,7 @@ void Hy3Layout::setTabLock(const CWorkspace* workspace, TabLockMode mode) {
 
 static void equalizeRecursive(Hy3Node* node, bool recursive) {
 	node->size_ratio = 1.0f;
+	if (node->parent) node->parent->markDirty();
 
 	if (recursive && node->is_group()) {
 		for (auto& child: node->as_group().children) {
@@ -1343,6 +1746,124 @@ void Hy3Layout::equalize(const CWorkspace* workspace, bool recursive) {
 	}
 }
 
+static size_t treeDepth(Hy3Node& node) {
+	if (!node.is_group()) return 1;
+
+	size_t depth = 0;
+	for (auto& child: node.as_group().children) {
+		depth = std::max(depth, treeDepth(*child));
+	}
+
+	return depth + 1;
+}
+
+// `keep` holds the focused node and the node exempted by the caller.
+static bool canFlatten(Hy3GroupNode& group, std::pair<Hy3Node*, Hy3Node*> keep) {
+	return group.isSplit() && group.expand_focused == ExpandFocusType::NotExpanded && !group.locked
+	    && !group.containment && &group != keep.first && &group != keep.second;
+}
+
+// Move the children of the split group at `index` into `group`, which has the same
+// layout, scaling ratios so every node keeps its share of the space.
+static void mergeChildGroup(Hy3GroupNode& group, size_t index) {
+	auto& child = group.children[index]->as_group();
+	auto outer_count = group.children.size();
+	auto inner_count = child.children.size();
+	auto scale = static_cast<double>(outer_count - 1 + inner_count) / outer_count;
+
+	for (auto& node: group.children) {
+		node->size_ratio *= scale;
+	}
+
+	for (auto& node: child.children) {
+		node->size_ratio = node->size_ratio / inner_count * child.size_ratio;
+	}
+
+	auto* focus = group.focused_child == &child ? child.focused_child : nullptr;
+	auto pos = index + 1;
+
+	while (!child.children.empty()) {
+		auto node = child.extractChildRaw(child.children.begin());
+		group.insertChild(group.children.begin() + pos++, std::move(node));
+	}
+
+	// drops the now empty group
+	group.extractChildRaw(group.children.begin() + index);
+	if (focus != nullptr) group.focused_child = focus;
+}
+
+static size_t normalizeGroup(Hy3GroupNode& group, std::pair<Hy3Node*, Hy3Node*> keep) {
+	static const auto group_inset = ConfigValue<Hyprlang::INT>("plugin:hy3:group_inset");
+	size_t removed = 0;
+
+	for (size_t i = 0; i < group.children.size();) {
+		if (!group.children[i]->is_group()) {
+			i++;
+			continue;
+		}
+
+		removed += normalizeGroup(group.children[i]->as_group(), keep);
+
+		// a split holding only another group adds nothing but an inset, keep it if there is one
+		while (*group_inset == 0) {
+			auto& child = group.children[i]->as_group();
+			if (!canFlatten(child, keep) || child.children.size() != 1
+			    || !child.children.front()->is_group())
+				break;
+
+			group.collapseChild(group.children.begin() + i);
+			removed++;
+		}
+
+		auto& child = group.children[i]->as_group();
+
+		// single child groups of the same layout are kept, as they are likely about to be added to
+		if (group.isSplit() && child.layout == group.layout && child.children.size() > 1
+		    && group.expand_focused == ExpandFocusType::NotExpanded && canFlatten(child, keep))
+		{
+			auto count = child.children.size();
+			mergeChildGroup(group, i);
+			removed++;
+			i += count;
+			continue;
+		}
+
+		i++;
+	}
+
+	return removed;
+}
+
+Hy3NormalizeResult Hy3Layout::normalize(Hy3Node* keep) {
+	if (!this->root) return {};
+
+	auto* focused = this->getWorkspaceFocusedNode(this->workspace().get());
+	auto result = Hy3NormalizeResult {.depth_before = treeDepth(*this->root)};
+	result.removed = normalizeGroup(*this->root, {focused, keep});
+	result.depth_after = treeDepth(*this->root);
+
+	if (result.removed != 0) {
+		hy3_log(
+		    LOG,
+		    "normalize: removed {} groups, tree depth {} -> {}",
+		    result.removed,
+		    result.depth_before,
+		    result.depth_after
+		);
+
+		this->invalidateFocusCache();
+		this->recalcGeometry();
+		this->updateGroupBorderColors();
+	}
+
+	return result;
+}
+
+void Hy3Layout::autoNormalize(Hy3Node* keep) {
+	static const auto auto_normalize = ConfigValue<Hyprlang::INT>("plugin:hy3:auto_normalize");
+	if (*auto_normalize) this->normalize(keep);
+}
+
 void Hy3Layout::warpCursorToBox(const Vector2D& pos, const Vector2D& size) {
 	auto cursorpos = g_pPointerManager->position();
 
@@ -1372,29 +1893,53 @@ std::string Hy3Layout::debugNodes() {
 	for (auto* hy3: g_hy3Instances) {
 		if (!hy3->root) continue;
 		output += hy3->root->debugNode();
-		output += "\n";
+
+		auto stats = hy3->node_pool->stats();
+		output += std::format(
+		    "\nnode pool: {} live, {} free, {} slabs\n",
+		    stats.live,
+		    stats.free,
+		    stats.slabs
+		);
+
+		auto& recalc = hy3->recalc_stats;
+		output += std::format(
+		    "recalc: {} nodes visited last pass, {} over {} passes\n",
+		    recalc.last_visited,
+		    recalc.total_visited,
+		    recalc.passes
+		);
+
+		auto& focus = hy3->focus_stats;
+		output += std::format(
+		    "focus: {} nodes touched last change, {} over {} changes\n",
+		    focus.last_touched,
+		    focus.total_touched,
+		    focus.changes
+		);
+	}
+
+	if (auto* atlas = Hy3GlyphAtlas::existing()) {
+		auto text = atlas->stats();
+		output += std::format(
+		    "text cache: {} hits, {} misses, {} evictions, {}/{} layouts cached, {}/{} atlas pages, "
+		    "{} atlas resets\n",
+		    text.hits,
+		    text.misses,
+		    text.evictions,
+		    text.cached,
+		    text.budget_layouts,
+		    text.pages,
+		    text.budget_pages,
+		    text.resets
+		);
 	}
 
 	return output;
 }
 
 bool Hy3Layout::shouldRenderSelected(const CWindow* window) {
-	if (window == nullptr) return false;
-	if (Desktop::focusState()->window()) return false;
-
-	auto* root = this->getWorkspaceRootGroup(window->m_workspace.get());
-	if (root == nullptr || root->as_group().focused_child == nullptr) return false;
-	auto* focused = &root->getFocusedNode();
-
-	switch (focused->type()) {
-	case Hy3NodeType::Target: return focused->as_window().get() == window;
-	case Hy3NodeType::Group: {
-		auto* node = this->getNodeFromWindow(window);
-		if (node == nullptr) return false;
-		return focused->as_group().hasChild(*node);
-	}
-	}
-	return false;
+	return window != nullptr && this->selected_windows.contains(window);
 }
 
 Hy3Node* Hy3Layout::getWorkspaceRootGroup(const CWorkspace* workspace) {
@@ -1409,35 +1954,140 @@ Hy3Node* Hy3Layout::getWorkspaceFocusedNode(
     bool ignore_group_focus,
     bool stop_at_expanded
 ) {
-	auto* rootNode = this->getWorkspaceRootGroup(workspace);
-	if (rootNode == nullptr) return nullptr;
-	return &rootNode->getFocusedNode(ignore_group_focus, stop_at_expanded);
+	this->updateFocusCache();
+	auto& cache = this->focus_cache;
+	if (cache.path.empty()) return nullptr;
+
+	auto index = (ignore_group_focus ? 1 : 0) | (stop_at_expanded ? 2 : 0);
+	if (cache.focused_resolved[index]) return cache.focused[index];
+
+	// same stopping rules as Hy3Node::getFocusedNode
+	Hy3Node* focused = cache.path.back();
+	for (auto* node: cache.path) {
+		if (node->is_target()) break;
+
+		auto& group = node->as_group();
+		if ((!ignore_group_focus && group.group_focused)
+		    || (stop_at_expanded && group.expand_focused != ExpandFocusType::NotExpanded))
+		{
+			focused = node;
+			break;
+		}
+	}
+
+	cache.focused[index] = focused;
+	cache.focused_resolved[index] = true;
+	return focused;
 }
 
-Hy3Node* Hy3Layout::getNodeFromWindow(const CWindow* window) {
-	if (!this->root || !window) return nullptr;
-	for (auto& w: this->root->windows()) {
-		if (&w == window) return getNodeFromTarget(w.layoutTarget());
+void Hy3Layout::updateFocusCache() {
+	auto& cache = this->focus_cache;
+	if (cache.valid) return;
+
+	cache = {};
+	cache.valid = true;
+
+	auto* node = this->getWorkspaceRootGroup(nullptr);
+	while (node != nullptr) {
+		cache.path.push_back(node);
+		node = node->is_group() ? node->as_group().focused_child : nullptr;
 	}
-	return nullptr;
 }
 
-static Hy3Node* findNodeFromTargetRecursive(Hy3Node* node, SP<Layout::ITarget> target) {
-	if (!node) return nullptr;
-	if (node->is_target() && node->as_target() == target) {
-		return node;
+void Hy3Layout::invalidateFocusCache() { this->focus_cache.valid = false; }
+
+Hy3Node& Hy3Layout::expandActorOf(Hy3Node& node) {
+	this->updateFocusCache();
+	auto& cache = this->focus_cache;
+
+	if (cache.actor_node != &node) {
+		cache.actor_node = &node;
+		cache.expand_actor = &node.getExpandActor();
+		cache.placement_actor = &cache.expand_actor->getPlacementActor();
 	}
-	if (node->is_group()) {
-		for (auto& child: node->as_group().children) {
-			auto* result = findNodeFromTargetRecursive(child.get(), target);
-			if (result) return result;
+
+	return *cache.expand_actor;
+}
+
+Hy3Node& Hy3Layout::placementActorOf(Hy3Node& node) {
+	this->expandActorOf(node);
+	return *this->focus_cache.placement_actor;
+}
+
+Hy3Node* Hy3Layout::getNodeFromWindow(const CWindow* window) {
+	if (window == nullptr) return nullptr;
+
+	auto it = this->window_nodes.find(window);
+	if (it == this->window_nodes.end()) return nullptr;
+
+	// guard against a stale entry for a reused window address
+	auto target = it->second->as<Hy3TargetNode>().target.lock();
+	if (!target || target->window().get() != window) return nullptr;
+
+	return it->second;
+}
+
+Hy3Node* Hy3Layout::getNodeFromTarget(SP<Layout::ITarget> target) {
+	if (!target) return nullptr;
+
+	auto it = this->target_nodes.find(target.get());
+	if (it == this->target_nodes.end()) return nullptr;
+	if (it->second->as<Hy3TargetNode>().target.get() != target.get()) return nullptr;
+
+	return it->second;
+}
+
+void Hy3Layout::attachSubtree(Hy3Node& node) {
+	// geometry committed under a previous parent (or layout) no longer applies
+	node.last_recalc.valid = false;
+
+	if (node.is_group()) {
+		for (auto& child: node.as_group().children) {
+			this->attachSubtree(*child);
 		}
+
+		return;
 	}
-	return nullptr;
+
+	auto& target_node = node.as<Hy3TargetNode>();
+	target_node.committed.valid = false;
+
+	auto target = target_node.target.lock();
+	if (!target) return;
+
+	this->target_nodes[target.get()] = &node;
+	if (auto window = target->window()) this->window_nodes[window.get()] = &node;
 }
 
-Hy3Node* Hy3Layout::getNodeFromTarget(SP<Layout::ITarget> target) {
-	return findNodeFromTargetRecursive(this->root.get(), target);
+template <typename K>
+static void eraseIndexEntry(std::unordered_map<K, Hy3Node*>& map, K key, Hy3Node& node) {
+	if (key != nullptr) {
+		auto it = map.find(key);
+		if (it != map.end() && it->second == &node) {
+			map.erase(it);
+			return;
+		}
+	}
+
+	// the key could not be resolved anymore (expired target or window)
+	std::erase_if(map, [&node](auto& entry) { return entry.second == &node; });
+}
+
+void Hy3Layout::detachSubtree(Hy3Node& node) {
+	if (node.is_group()) {
+		for (auto& child: node.as_group().children) {
+			this->detachSubtree(*child);
+		}
+
+		return;
+	}
+
+	auto target = node.as<Hy3TargetNode>().target.lock();
+	auto window = target ? target->window() : nullptr;
+
+	eraseIndexEntry<const Layout::ITarget*>(this->target_nodes, target.get(), node);
+	eraseIndexEntry<const CWindow*>(this->window_nodes, window.get(), node);
+	this->spatial_index.remove(&node);
 }
 
 bool shiftIsForward(ShiftDirection direction) {
@@ -1454,6 +2104,106 @@ bool shiftMatchesLayout(Hy3GroupLayout layout, ShiftDirection direction) {
 	    || (layout != Hy3GroupLayout::SplitV && !shiftIsVertical(direction));
 }
 
+Hy3Node* Hy3Layout::findGeometricNeighbor(Hy3Node& from, ShiftDirection direction) {
+	this->flushGeometry();
+
+	auto& index = this->spatial_index;
+	if (index.empty()) return nullptr;
+
+	auto bounds = index.bounds();
+	auto cell = index.cellSize();
+	auto vertical = shiftIsVertical(direction);
+	auto forward = shiftIsForward(direction);
+	auto source = from.visualBox;
+
+	// Distances along the direction of movement, growing away from `from`.
+	auto nearEdge = [&](const CBox& box) {
+		if (vertical) return forward ? box.y : -(box.y + box.h);
+		else return forward ? box.x : -(box.x + box.w);
+	};
+
+	auto farEdge = [&](const CBox& box) {
+		if (vertical) return forward ? box.y + box.h : -box.y;
+		else return forward ? box.x + box.w : -box.x;
+	};
+
+	auto crossOverlap = [&](const CBox& box) {
+		if (vertical) return std::min(box.x + box.w, source.x + source.w) - std::max(box.x, source.x);
+		else return std::min(box.y + box.h, source.y + source.h) - std::max(box.y, source.y);
+	};
+
+	auto crossDistance = [&](const CBox& box) {
+		auto center = box.middle();
+		auto source_center = source.middle();
+		return vertical ? std::abs(center.x - source_center.x) : std::abs(center.y - source_center.y);
+	};
+
+	// A little slack so neighbors touching or overlapping the edge by rounding still count.
+	auto edge = farEdge(source) - 2.0;
+	auto limit = farEdge(bounds);
+
+	Hy3Node* best = nullptr;
+	double best_distance = 0;
+	double best_cross = 0;
+	bool best_overlaps = false;
+
+	// Sweep outward in cell sized bands, stopping after the first band containing
+	// a candidate that lines up with `from`. Candidates that don't line up are only
+	// taken if nothing does.
+	for (auto band = edge; band < limit; band += cell) {
+		auto area = vertical ? CBox(bounds.x, forward ? band : -(band + cell), bounds.w, cell)
+		                     : CBox(forward ? band : -(band + cell), bounds.y, cell, bounds.h);
+
+		index.query(area, [&](Hy3Node* node, const CBox& box) {
+			// consider each node in the band containing its near edge only
+			auto distance = nearEdge(box);
+			if (distance < band || distance >= band + cell) return;
+			// hasChild compares euler tour labels, excluding every descendant of `from`
+			if (node == &from || (from.is_group() && from.as_group().hasChild(*node))) return;
+
+			auto overlap = crossOverlap(box);
+			auto overlaps = overlap > 0;
+			auto cross = overlaps ? -overlap : crossDistance(box);
+
+			if (best != nullptr) {
+				if (best_overlaps && !overlaps) return;
+				if (best_overlaps == overlaps
+				    && (distance > best_distance || (distance == best_distance && cross >= best_cross)))
+					return;
+			}
+
+			best = node;
+			best_distance = distance;
+			best_cross = cross;
+			best_overlaps = overlaps;
+		});
+
+		if (best_overlaps) break;
+	}
+
+	return best;
+}
+
+void Hy3Layout::moveNodeBeside(Hy3Node& node, Hy3Node& target, ShiftDirection direction) {
+	auto* old_parent = node.parent.get();
+	if (old_parent == nullptr || target.parent == nullptr) return;
+
+	auto node_up = old_parent->extractAndMerge(node, nullptr, nodeCollapsePolicy());
+
+	// the merge may have moved `target` into a different group
+	auto& group = target.parent->as_group();
+	auto it = group.findChild(target);
+
+	// entering a split along its axis lands on the near side of the target
+	if (!(group.isSplit() && shiftMatchesLayout(group.layout, direction) && shiftIsForward(direction)))
+		++it;
+
+	group.insertChild(it, std::move(node_up));
+
+	node.focus(false, Desktop::FOCUS_REASON_KEYBIND);
+	this->recalcGeometry();
+}
+
 Hy3Node* Hy3Layout::shiftOrGetFocus(
     Hy3Node& node,
     ShiftDirection direction,
@@ -1461,8 +2211,8 @@ Hy3Node* Hy3Layout::shiftOrGetFocus(
     bool once,
     bool visible
 ) {
-	auto* expand_actor = &node.getExpandActor();
-	auto* break_origin = &expand_actor->getPlacementActor();
+	auto* expand_actor = &this->expandActorOf(node);
+	auto* break_origin = &this->placementActorOf(node);
 	auto* shift_actor = break_origin;
 	auto* break_parent = break_origin->parent.get();
 
@@ -1514,7 +2264,7 @@ Hy3Node* Hy3Layout::shiftOrGetFocus(
 
 	auto& parent_group = break_parent->as_group();
 	Hy3Node* target_group = break_parent;
-	std::list<UP<Hy3Node>>::iterator insert;
+	std::vector<UP<Hy3Node>>::iterator insert;
 
 	if (break_origin == parent_group.children.front().get() && !shiftIsForward(direction)) {
 		if (!shift) return nullptr;
@@ -1609,15 +2359,15 @@ Hy3Node* Hy3Layout::shiftOrGetFocus(
 	auto& group_data = target_group->as_group();
 
 	if (target_group == shift_actor->parent.get()) {
-		// Reorder within the same group via splice (handles boundary no-ops naturally)
+		// Reorder within the same group (handles boundary no-ops naturally)
 		auto shift_it = group_data.findChild(*shift_actor);
-		group_data.children.splice(insert, group_data.children, shift_it);
+		group_data.moveChild(shift_it, insert);
 		shift_actor->parent->collapseParents(nodeCollapsePolicy());
 	} else if (!shift_actor->parent->is_root() && shift_actor->parent->as_group().children.size() == 1 && target_group == shift_actor->parent->parent.get()) {
 		// special cased to prevent size being reset to 1 on group break
 		auto shift_parent = shift_actor->parent;
 		auto shift_actor_u = shift_parent->as_group().extractChildRaw(*shift_actor);
-		auto iter = std::ranges::find(group_data.children, shift_parent);
+		auto iter = group_data.findChild(*shift_parent.get());
 		group_data.replaceChild(iter, std::move(shift_actor_u));
 	} else {
 		auto target_group_p = target_group->self;
@@ -9,7 +9,9 @@ enum class GroupEphemeralityOption {
 	ForceEphemeral,
 };
 
+#include <array>
 #include <set>
+#include <unordered_map>
 
 #include <hyprland/src/layout/algorithm/TiledAlgorithm.hpp>
 #include <hyprland/src/layout/algorithm/Algorithm.hpp>
@@ -44,6 +46,8 @@ inline static Math::eDirection shiftToMathDirection(ShiftDirection direction) {
 
 enum class Axis { None, Horizontal, Vertical };
 
+#include "NodePool.hpp"
+#include "SpatialIndex.hpp"
 #include "Hy3Node.hpp"
 #include "TabGroup.hpp"
 
@@ -97,6 +101,39 @@ enum class ExpandFullscreenOption {
 
 PHLWORKSPACE workspace_for_action(bool allow_fullscreen = false);
 
+enum class Hy3DropZone {
+	Before,
+	After,
+	// wrap the target in a new group, placing the dropped node before or after it
+	WrapBefore,
+	WrapAfter,
+};
+
+// Where a node dropped with the mouse will be inserted.
+struct Hy3DropTarget {
+	Hy3Node* node; // placement actor the dropped node lands beside
+	Hy3DropZone zone;
+	Hy3GroupLayout wrap_layout; // layout of the new group for Wrap zones
+	CBox preview; // area the dropped node will roughly take up
+};
+
+// Outcome of Hy3Layout::normalize.
+struct Hy3NormalizeResult {
+	size_t removed = 0; // groups removed
+	size_t depth_before = 0;
+	size_t depth_after = 0;
+};
+
+// Clickable area of a visible tab bar, with the span of each tab in global x.
+struct Hy3TabBarHitArea {
+	Hy3Node* group;
+	CBox rect;
+	size_t order; // pre-order position, outer bars win over nested ones
+	std::vector<double> starts;
+	std::vector<double> ends;
+	std::vector<Hy3Node*> tabs;
+};
+
 class Hy3Layout: public Layout::ITiledAlgorithm {
 public:
 	Hy3Layout();
@@ -108,13 +145,36 @@ public:
 	void removeTarget(SP<Layout::ITarget> target) override;
 	void resizeTarget(const Vector2D& delta, SP<Layout::ITarget> target, Layout::eRectCorner corner = Layout::CORNER_NONE) override;
 	void recalculate() override;
-	void recalcGeometry(bool no_animation = false);
+	// Recalculate node geometry, only visiting dirty subtrees unless `force` is set.
+	// Deferred while a transaction is open, or until the next frame (or flushGeometry)
+	// when plugin:hy3:deferred_layout is set.
+	void recalcGeometry(bool no_animation = false, bool force = false);
+	// Run a deferred recalcGeometry now, for code that reads node boxes or window positions.
+	void flushGeometry();
 	void swapTargets(SP<Layout::ITarget> a, SP<Layout::ITarget> b) override;
 	void moveTargetInDirection(SP<Layout::ITarget> t, Math::eDirection dir, bool silent) override;
 	std::expected<void, std::string> layoutMsg(const std::string_view& sv) override;
 	std::optional<Vector2D> predictSizeForNewTarget() override;
 	SP<Layout::ITarget> getNextCandidate(SP<Layout::ITarget> old) override;
 
+	// Defers recalcGeometry, tab bar updates and border color updates on a layout
+	// until the outermost transaction on it ends, then runs each of them once.
+	class Transaction {
+	public:
+		explicit Transaction(Hy3Layout* layout);
+		~Transaction();
+		Transaction(const Transaction&) = delete;
+		Transaction& operator=(const Transaction&) = delete;
+
+	private:
+		Hy3Layout* layout;
+	};
+
+	// Run deferred transaction work now, for code that needs committed geometry.
+	void flushPending();
+	// Queue a tab bar update if a transaction is open. Returns false if it should run now.
+	bool deferTabBarUpdate(Hy3GroupNode&, bool no_animation);
+
 	// Hy3-specific public methods
 	void insertNode(UP<Hy3Node> node, std::optional<Vector2D> focalPoint = std::nullopt);
 	void onWindowFocusChange(PHLWINDOW window);
@@ -140,8 +200,23 @@ public:
 	void changeGroupToOppositeOn(Hy3Node&);
 	void changeGroupEphemeralityOn(Hy3Node&, bool ephemeral);
 	void shiftNode(Hy3Node&, ShiftDirection, bool once, bool visible);
-	void shiftWindow(const CWorkspace* workspace, ShiftDirection, bool once, bool visible);
-	void shiftFocus(const CWorkspace* workspace, ShiftDirection, bool visible, bool warp);
+	void shiftWindow(
+	    const CWorkspace* workspace,
+	    ShiftDirection,
+	    bool once,
+	    bool visible,
+	    bool geometric = false
+	);
+	void shiftFocus(
+	    const CWorkspace* workspace,
+	    ShiftDirection,
+	    bool visible,
+	    bool warp,
+	    bool geometric = false
+	);
+	// Nearest visible target node past the edge of `from` in the given direction, by
+	// on-screen geometry rather than tree structure. Nodes inside `from` are skipped.
+	Hy3Node* findGeometricNeighbor(Hy3Node& from, ShiftDirection);
 	void toggleFocusLayer(const CWorkspace* workspace, bool warp);
 	bool shiftMonitor(Hy3Node&, ShiftDirection, bool follow);
 	Hy3Node* focusMonitor(ShiftDirection);
@@ -161,13 +236,31 @@ public:
 	void expand(const CWorkspace* workspace, ExpandOption, ExpandFullscreenOption);
 	void setTabLock(const CWorkspace* workspace, TabLockMode);
 	void equalize(const CWorkspace* workspace, bool recursive = false);
+	// Flatten redundant nesting without changing ratios: chains of single-child split
+	// groups, and split groups nested in a split of the same orientation.
+	// Groups holding a single group are left alone while plugin:hy3:group_inset is set,
+	// as removing them would remove their inset. `keep` is never removed.
+	Hy3NormalizeResult normalize(Hy3Node* keep = nullptr);
+	// Drop target for a tiled node released at `pos`, or nullopt if no node is under it.
+	std::optional<Hy3DropTarget> resolveDrop(Vector2D pos);
+	// Drop zone of `node` containing `pos`, relative to the group `node` is in.
+	Hy3DropTarget dropTargetFor(Hy3Node& node, Vector2D pos);
+	// Find the tab bar under `pos` inside `from`, setting `focused_node` to the tab there.
+	// Returns the tab group if it is reached from `from` through tab groups only,
+	// otherwise the child of the first non-tab group on the way down.
+	Hy3Node* findTabBarAt(Hy3Node& from, Vector2D pos, Hy3Node** focused_node);
+	void invalidateTabBarIndex() { this->tab_bar_index.valid = false; }
 	static void warpCursorToBox(const Vector2D& pos, const Vector2D& size);
 	static void warpCursorWithFocus(const Vector2D& pos, bool force = false);
 	static std::string debugNodes();
 
+	// True if the window carries the group selection border as of the last border update.
 	bool shouldRenderSelected(const Desktop::View::CWindow*);
 	PHLWINDOW findTiledWindowCandidate(const Desktop::View::CWindow* from);
 	PHLWINDOW findFloatingWindowCandidate(const Desktop::View::CWindow* from);
+	// Floating windows on this workspace, see floating_windows.
+	void trackFloatingWindow(const PHLWINDOW& window);
+	void untrackFloatingWindow(const Desktop::View::CWindow* window);
 
 	Hy3Node* getWorkspaceRootGroup(const CWorkspace* workspace);
 	Hy3Node* getWorkspaceFocusedNode(
@@ -176,13 +269,42 @@ public:
 	    bool stop_at_expanded = false
 	);
 
+	// Expand and placement actors of a node, cached for the last node asked about
+	// (normally the focused one) until invalidateFocusCache.
+	Hy3Node& expandActorOf(Hy3Node&);
+	Hy3Node& placementActorOf(Hy3Node&);
+	// Drop cached focus resolution. Called on focus changes and tree mutations.
+	void invalidateFocusCache();
+
 	Hy3Node* getNodeFromWindow(const Desktop::View::CWindow*);
 	Hy3Node* getNodeFromTarget(SP<Layout::ITarget> target);
 
+	// Keep the window/target lookup tables in sync with a subtree entering or
+	// leaving this layout's tree. Called by Hy3GroupNode's child mutators.
+	void attachSubtree(Hy3Node&);
+	void detachSubtree(Hy3Node&);
+
 	PHLWORKSPACE workspace();
 	CMonitor* monitor();
+	Hy3NodePool* nodePool() { return this->node_pool; }
 
 	UP<Hy3RootNode> root;
+	// The workspace holds a single window that is not in a group, see updateSingleWindow.
+	bool single_window = false;
+
+	// Nodes visited by recalcGeometry, reported by hy3:debugnodes.
+	struct {
+		size_t last_visited = 0;
+		size_t total_visited = 0;
+		size_t passes = 0;
+	} recalc_stats;
+
+	// Nodes whose decorations or tab bars were refreshed by markFocused.
+	struct {
+		size_t last_touched = 0;
+		size_t total_touched = 0;
+		size_t changes = 0;
+	} focus_stats;
 
 private:
 	// if shift is true, shift the window in the given direction, returning
@@ -190,6 +312,15 @@ private:
 	// nullptr. if once is true, only one group will be broken out of / into
 	Hy3Node* shiftOrGetFocus(Hy3Node&, ShiftDirection, bool shift, bool once, bool visible);
 
+	void applyGeometry(bool no_animation, bool force);
+	// Refresh single_window, passing changes on to the workspace's tab groups.
+	void updateSingleWindow(const PHLWORKSPACE& workspace);
+	// normalize(keep) if plugin:hy3:auto_normalize is set
+	void autoNormalize(Hy3Node* keep = nullptr);
+	// Move a node next to `target`, entering it from the given direction.
+	void moveNodeBeside(Hy3Node& node, Hy3Node& target, ShiftDirection);
+	void applyGroupBorderColors();
+
 	void updateAutotileWorkspaces();
 	bool shouldAutotileWorkspace(const CWorkspace* workspace);
 
@@ -203,5 +334,63 @@ private:
 		std::set<int> workspaces;
 	} autotile;
 
+	// Focus resolution cached by getWorkspaceFocusedNode and the actor accessors.
+	struct {
+		bool valid = false;
+		// root group down to the deepest focused node, ignoring group focus and expansion
+		std::vector<Hy3Node*> path;
+		// indexed by ignore_group_focus | stop_at_expanded << 1
+		std::array<Hy3Node*, 4> focused {};
+		std::array<bool, 4> focused_resolved {};
+		Hy3Node* actor_node = nullptr;
+		Hy3Node* expand_actor = nullptr;
+		Hy3Node* placement_actor = nullptr;
+	} focus_cache;
+
+	void updateFocusCache();
+
+	// Windows that became floating on this workspace: opened or moved here
+	// floating, or removed from the tiled tree. Entries are rechecked on lookup,
+	// which orders them by g_zOrder.
+	std::vector<PHLWINDOWREF> floating_windows;
+	bool floating_seeded = false;
+
+	// Windows currently carrying the group selection border, see updateGroupBorderColors.
+	std::unordered_map<const Desktop::View::CWindow*, PHLWINDOWREF> selected_windows;
+
+	// Work deferred by open transactions.
+	struct {
+		int depth = 0;
+		bool recalc = false;
+		bool no_animation = false;
+		bool force = false;
+		bool borders = false;
+		std::vector<WP<Hy3Node>> tab_bars;
+	} pending;
+
+	// Backing storage for this layout's nodes. Released (not freed) on destruction,
+	// as nodes moved to other layouts may still live in it.
+	Hy3NodePool* node_pool = Hy3NodePool::create();
+
+	// Every target node reachable from `root`, keyed by its target and window.
+	std::unordered_map<const Layout::ITarget*, Hy3Node*> target_nodes;
+	std::unordered_map<const Desktop::View::CWindow*, Hy3Node*> window_nodes;
+
+	// Committed visual boxes of visible target nodes, kept up to date by recalcGeometry.
+	Hy3SpatialGrid<Hy3Node> spatial_index;
+
+	// Visible tab bars for findTabBarAt. Rebuilt on the next lookup after geometry
+	// or tab bar changes, and on every lookup while tab bars are animating.
+	struct {
+		bool valid = false;
+		std::vector<Hy3TabBarHitArea> areas;
+		Hy3SpatialGrid<Hy3TabBarHitArea> grid;
+	} tab_bar_index;
+
+	void rebuildTabBarIndex();
+
+	// Placement actor of the visible node nearest `pos`, within gaps and borders of it.
+	Hy3Node* findDropNode(Vector2D pos);
+
 	friend struct Hy3Node;
 };
@@ -1,3 +1,4 @@
+#include <algorithm>
 #include <cstdint>
 #include <sstream>
 #include <stdexcept>
@@ -19,24 +20,31 @@ using Desktop::View::CWindow;
 
 const float MIN_RATIO = 0.0f;
 
-Hy3GroupNode::Hy3GroupNode(Hy3GroupLayout layout): layout(layout) {
+Hy3GroupNode::Hy3GroupNode(Hy3GroupLayout layout): Hy3Node(Hy3NodeType::Group), layout(layout) {
 	if (!isTab()) {
 		this->previous_nontab_layout = layout;
 	}
 }
 
-bool Hy3Node::is_root() { return is_group() && as_group().layout == Hy3GroupLayout::Root; }
+bool Hy3Node::is_root() const {
+	return this->is_group() && static_cast<const Hy3GroupNode*>(this)->layout == Hy3GroupLayout::Root;
+}
+
 bool Hy3Node::is_root_group() { return !is_root() && parent->is_root(); }
 
 Hy3RootNode::Hy3RootNode(Hy3Layout* layout)
-    : Hy3GroupNode(Hy3GroupLayout::Root), algo(layout) {}
+    : Hy3GroupNode(Hy3GroupLayout::Root), algo(layout) {
+	this->label_root = this;
+	this->label_enter = 0;
+	this->label_exit = UINT64_MAX;
+}
 
 Hy3RootNode* Hy3Node::root() {
 	auto* node = this;
 	while (!node->is_root() && node->parent.get() != nullptr) {
 		node = node->parent.get();
 	}
-	return dynamic_cast<Hy3RootNode*>(node);
+	return node->is_root() ? static_cast<Hy3RootNode*>(node) : nullptr;
 }
 
 Hy3Layout* Hy3Node::layout() {
@@ -52,6 +60,11 @@ void Hy3Node::assertNotRoot() {
 }
 
 bool Hy3GroupNode::hasChild(Hy3Node& node) {
+	if (this->label_root != nullptr && node.label_root == this->label_root) {
+		return this->label_enter < node.label_enter && node.label_exit < this->label_exit;
+	}
+
+	// unlabelled (detached) trees fall back to a search
 	for (auto& child: this->children) {
 		if (child.get() == &node) return true;
 
@@ -63,17 +76,87 @@ bool Hy3GroupNode::hasChild(Hy3Node& node) {
 	return false;
 }
 
-auto Hy3GroupNode::findChild(Hy3Node& child) -> std::list<UP<Hy3Node>>::iterator {
-	for (auto it = children.begin(); it != children.end(); ++it) {
-		if (it->get() == &child) return it;
+bool Hy3Node::precedes(const Hy3Node& other) const {
+	return this->label_root != nullptr && this->label_root == other.label_root
+	    && this->label_enter < other.label_enter;
+}
+
+static size_t countNodes(Hy3Node& node) {
+	size_t count = 0;
+	node.forEachNode([&](Hy3Node&) { count++; });
+	return count;
+}
+
+static void clearLabels(Hy3Node& node) {
+	node.forEachNode([](Hy3Node& child) { child.label_root = nullptr; });
+}
+
+// Spread the labels of `node`'s subtree evenly over the open interval (left, right).
+// Returns false if there is not enough room.
+static bool labelSubtree(Hy3Node& node, Hy3Node* root, uint64_t left, uint64_t right) {
+	auto needed = countNodes(node) * 2;
+	auto step = (right - left) / (needed + 1);
+	if (step == 0) return false;
+
+	auto next = left;
+	auto assign = [&](auto& self, Hy3Node& n) -> void {
+		n.label_root = root;
+		n.label_enter = next += step;
+
+		if (n.is_group()) {
+			for (auto& child: n.as_group().children) {
+				self(self, *child);
+			}
+		}
+
+		n.label_exit = next += step;
+	};
+
+	assign(assign, node);
+	return true;
+}
+
+void Hy3GroupNode::labelChild(size_t index) {
+	if (this->label_root == nullptr) return;
+
+	auto left = index == 0 ? this->label_enter : this->children[index - 1]->label_exit;
+	auto right = index + 1 == this->children.size() ? this->label_exit
+	                                                 : this->children[index + 1]->label_enter;
+
+	if (!labelSubtree(*this->children[index], this->label_root, left, right)) {
+		// out of room between the neighbors, respread the whole tree
+		labelSubtree(*this->label_root, this->label_root, 0, UINT64_MAX);
+	}
+}
+
+void Hy3GroupNode::reindexChildren(size_t from, size_t to) {
+	to = std::min(to, this->children.size());
+	for (auto i = from; i < to; i++) {
+		this->children[i]->child_index = i;
 	}
-	return children.end();
 }
 
-void Hy3GroupNode::insertChild(std::list<UP<Hy3Node>>::iterator pos, UP<Hy3Node> child) {
+auto Hy3GroupNode::findChild(Hy3Node& child) -> std::vector<UP<Hy3Node>>::iterator {
+	if (child.parent.get() != this || child.child_index >= children.size()
+	    || children[child.child_index].get() != &child)
+		return children.end();
+
+	return children.begin() + child.child_index;
+}
+
+void Hy3GroupNode::insertChild(std::vector<UP<Hy3Node>>::iterator pos, UP<Hy3Node> child) {
+	auto index = static_cast<size_t>(pos - children.begin());
 	child->parent = this->self;
 	if (focused_child == nullptr) focused_child = child.get();
+	if (auto* layout = this->layout()) {
+		layout->attachSubtree(*child);
+		layout->invalidateFocusCache();
+	}
+	this->adjustCounts(child->counts);
+	this->markDirty();
 	children.insert(pos, std::move(child));
+	reindexChildren(index, children.size());
+	labelChild(index);
 	if (ephemeral == Ephemeral::Staged && children.size() >= 2)
 		ephemeral = Ephemeral::Active;
 }
@@ -82,8 +165,9 @@ void Hy3GroupNode::insertChild(UP<Hy3Node> child) {
 	insertChild(children.end(), std::move(child));
 }
 
-UP<Hy3Node> Hy3GroupNode::extractChildRaw(std::list<UP<Hy3Node>>::iterator it) {
+UP<Hy3Node> Hy3GroupNode::extractChildRaw(std::vector<UP<Hy3Node>>::iterator it) {
 	auto* child_ptr = it->get();
+	auto index = static_cast<size_t>(it - children.begin());
 
 	// Fix focused_child if we're extracting it
 	if (focused_child == child_ptr) {
@@ -96,9 +180,19 @@ UP<Hy3Node> Hy3GroupNode::extractChildRaw(std::list<UP<Hy3Node>>::iterator it) {
 		}
 	}
 
+	if (auto* layout = this->layout()) {
+		layout->detachSubtree(*child_ptr);
+		layout->invalidateFocusCache();
+	}
+	this->adjustCounts(child_ptr->counts, true);
+	this->markDirty();
+
 	auto up = std::move(*it);
 	children.erase(it);
+	reindexChildren(index, children.size());
+	clearLabels(*up);
 	up->parent.reset();
+	up->child_index = 0;
 	return up;
 }
 
@@ -134,31 +228,94 @@ UP<Hy3Node> Hy3GroupNode::extractChild(Hy3Node& child) {
 	return extracted;
 }
 
-UP<Hy3Node> Hy3GroupNode::replaceChild(std::list<UP<Hy3Node>>::iterator it, UP<Hy3Node> replacement) {
+UP<Hy3Node> Hy3GroupNode::replaceChild(std::vector<UP<Hy3Node>>::iterator it, UP<Hy3Node> replacement) {
 	replacement->parent = this->self;
 	replacement->size_ratio = (*it)->size_ratio;
+	replacement->child_index = (*it)->child_index;
 	if (focused_child == it->get()) focused_child = replacement.get();
+
+	if (auto* layout = this->layout()) {
+		layout->detachSubtree(**it);
+		layout->attachSubtree(*replacement);
+		layout->invalidateFocusCache();
+	}
+
+	this->adjustCounts((*it)->counts, true);
+	this->adjustCounts(replacement->counts);
+	this->markDirty();
+
 	auto old = std::exchange(*it, std::move(replacement));
+	clearLabels(*old);
+	labelChild(old->child_index);
+	old->size_ratio = 1.0;
+	old->parent.reset();
+	old->child_index = 0;
+	return old;
+}
+
+UP<Hy3Node> Hy3GroupNode::collapseChild(std::vector<UP<Hy3Node>>::iterator it) {
+	auto& group = (*it)->as_group();
+	auto child = std::move(group.children.front());
+	group.children.clear();
+	group.focused_child = nullptr;
+
+	// The child stays in this layout and its labels already nest inside the group's,
+	// so the lookup tables, counts and labels need no walk.
+	child->parent = this->self;
+	child->size_ratio = (*it)->size_ratio;
+	child->child_index = (*it)->child_index;
+	if (focused_child == it->get()) focused_child = child.get();
+
+	auto old = std::exchange(*it, std::move(child));
+	old->counts = {};
+	old->label_root = nullptr;
 	old->size_ratio = 1.0;
 	old->parent.reset();
+	old->child_index = 0;
+
+	if (auto* layout = this->layout()) layout->invalidateFocusCache();
+	this->markDirty();
 	return old;
 }
 
+void Hy3GroupNode::moveChild(
+    std::vector<UP<Hy3Node>>::iterator from,
+    std::vector<UP<Hy3Node>>::iterator to
+) {
+	auto from_index = static_cast<size_t>(from - children.begin());
+	auto to_index = static_cast<size_t>(to - children.begin());
+	this->markDirty();
+
+	if (from_index < to_index) {
+		std::rotate(from, std::next(from), to);
+		reindexChildren(from_index, to_index);
+		labelChild(to_index - 1);
+	} else if (to_index < from_index) {
+		std::rotate(to, from, std::next(from));
+		reindexChildren(to_index, from_index + 1);
+		labelChild(to_index);
+	}
+}
+
 void Hy3GroupNode::collapseExpansions() {
 	if (this->expand_focused == ExpandFocusType::NotExpanded) return;
 	this->expand_focused = ExpandFocusType::NotExpanded;
+	this->markDirty();
+	if (auto* layout = this->layout()) layout->invalidateFocusCache();
 
 	Hy3Node* node = this->focused_child;
 
 	while (node->is_group() && node->as_group().expand_focused == ExpandFocusType::Stack) {
 		auto& group = node->as_group();
 		group.expand_focused = ExpandFocusType::NotExpanded;
+		group.markDirty();
 		node = group.focused_child;
 	}
 }
 
 void Hy3GroupNode::setLayout(Hy3GroupLayout layout) {
 	if (layout == Hy3GroupLayout::Root) return; // root layout is immutable
+	if (this->layout != layout) this->markDirty();
 	this->layout = layout;
 
 	if (!isTab()) {
@@ -179,30 +336,28 @@ void Hy3GroupNode::setEphemeral(GroupEphemeralityOption ephemeral) {
 }
 
 bool Hy3Node::valid() const {
-	if (dynamic_cast<const Hy3GroupNode*>(this)) return true;
-	if (auto* t = dynamic_cast<const Hy3TargetNode*>(this)) return !t->target.expired();
+	switch (this->kind) {
+	case Hy3NodeType::Group: return true;
+	case Hy3NodeType::Target: return !static_cast<const Hy3TargetNode*>(this)->target.expired();
+	}
+
 	return false;
 }
 
-Hy3NodeType Hy3Node::type() const {
-	if (dynamic_cast<const Hy3GroupNode*>(this)) return Hy3NodeType::Group;
-	if (dynamic_cast<const Hy3TargetNode*>(this)) return Hy3NodeType::Target;
-	throw std::runtime_error("Attempted to get Hy3NodeType of uninitialized Hy3Node data");
-}
+Hy3NodeType Hy3Node::type() const { return this->kind; }
 
-bool Hy3Node::is_group() const { return dynamic_cast<const Hy3GroupNode*>(this) != nullptr; }
+bool Hy3Node::is_group() const { return this->kind == Hy3NodeType::Group; }
 
-bool Hy3Node::is_target() const { return dynamic_cast<const Hy3TargetNode*>(this) != nullptr; }
+bool Hy3Node::is_target() const { return this->kind == Hy3NodeType::Target; }
 
 Hy3GroupNode& Hy3Node::as_group() {
-	auto* gn = dynamic_cast<Hy3GroupNode*>(this);
-	if (!gn) throw std::runtime_error("Attempted to get group value of a non-group Hy3Node");
-	return *gn;
+	if (!this->is_group()) throw std::runtime_error("Attempted to get group value of a non-group Hy3Node");
+	return *static_cast<Hy3GroupNode*>(this);
 }
 
 SP<Layout::ITarget> Hy3Node::as_target() {
-	auto* tn = dynamic_cast<Hy3TargetNode*>(this);
-	if (!tn) throw std::runtime_error("Attempted to get target value of a non-target Hy3Node");
+	if (!this->is_target()) throw std::runtime_error("Attempted to get target value of a non-target Hy3Node");
+	auto* tn = static_cast<Hy3TargetNode*>(this);
 	if (tn->target.expired()) throw std::runtime_error("Attempted to upgrade an expired Hy3Node target");
 	return tn->target.lock();
 }
@@ -211,21 +366,29 @@ PHLWINDOW Hy3Node::as_window() {
 	return this->as_target()->window();
 }
 
-UP<Hy3Node> Hy3Node::create(SP<Layout::ITarget> target) {
-	auto up = makeUnique<Hy3TargetNode>();
-	up->target = target;
-	UP<Hy3Node> result = std::move(up);
+UP<Hy3Node> Hy3Node::create(SP<Layout::ITarget> target, Hy3NodePool* pool) {
+	auto* node = pool ? new (*pool) Hy3TargetNode() : new Hy3TargetNode();
+	node->target = target;
+
+	auto window = target ? target->window() : nullptr;
+	node->counts = {.windows = 1, .urgent = window && window->m_isUrgent ? 1u : 0u, .visible = 1};
+	UP<Hy3Node> result(static_cast<Hy3Node*>(node));
 	result->self = WP<Hy3Node>(result);
 	return result;
 }
 
-UP<Hy3Node> Hy3Node::create(Hy3GroupLayout group_layout) {
-	auto up = makeUnique<Hy3GroupNode>(group_layout);
-	UP<Hy3Node> result = std::move(up);
+UP<Hy3Node> Hy3Node::create(Hy3GroupLayout group_layout, Hy3NodePool* pool) {
+	auto* node = pool ? new (*pool) Hy3GroupNode(group_layout) : new Hy3GroupNode(group_layout);
+	UP<Hy3Node> result(static_cast<Hy3Node*>(node));
 	result->self = WP<Hy3Node>(result);
 	return result;
 }
 
+void* Hy3Node::operator new(size_t size) { return Hy3NodePool::allocateUnpooled(size); }
+void* Hy3Node::operator new(size_t size, Hy3NodePool& pool) { return pool.allocate(size); }
+void Hy3Node::operator delete(void* ptr) { Hy3NodePool::deallocate(ptr); }
+void Hy3Node::operator delete(void* ptr, Hy3NodePool&) { Hy3NodePool::deallocate(ptr); }
+
 bool Hy3Node::operator==(const Hy3Node& rhs) const { return this == &rhs; }
 
 void Hy3Node::focus(bool warp, Desktop::eFocusReason reason) {
@@ -237,44 +400,104 @@ void Hy3Node::focus(bool warp, Desktop::eFocusReason reason) {
 	case Hy3NodeType::Target: {
 		auto window = this->as_window();
 		window->setHidden(false);
+		this->as<Hy3TargetNode>().committed.hidden = false;
 		Desktop::focusState()->fullWindowFocus(window, reason);
-		if (warp) Hy3Layout::warpCursorToBox(window->m_position, window->m_size);
+		if (warp) {
+			if (auto* layout = this->layout()) layout->flushGeometry();
+			Hy3Layout::warpCursorToBox(window->m_position, window->m_size);
+		}
 		break;
 	}
 	case Hy3NodeType::Group: {
 		Desktop::focusState()->resetWindowFocus();
-		for (auto& window: this->windows()) {
+		this->forEachWindow([](CWindow& window) {
 			g_pCompositor->changeWindowZOrder(window.m_self.lock(), true);
-		}
+			g_zOrder.raise(&window);
+		});
 
-		if (warp) Hy3Layout::warpCursorToBox(this->visualBox.pos(), this->visualBox.size());
+		if (warp) {
+			if (auto* layout = this->layout()) layout->flushGeometry();
+			Hy3Layout::warpCursorToBox(this->visualBox.pos(), this->visualBox.size());
+		}
 		break;
 	}
 	}
 }
 
 void markGroupFocusedRecursive(Hy3GroupNode& group) {
+	if (!group.group_focused && group.isTab()) group.markDirty();
 	group.group_focused = true;
 	for (auto& child: group.children) {
 		if (child->is_group()) markGroupFocusedRecursive(child->as_group());
 	}
 }
 
+// Collect the nodes that display focus state: the focus path from the root down,
+// and the entire subtree of a focused group.
+static void collectFocusRegion(Hy3Node& root, std::vector<Hy3Node*>& region) {
+	auto* node = &root;
+
+	while (node != nullptr) {
+		if (node->is_target()) {
+			region.push_back(node);
+			return;
+		}
+
+		auto& group = node->as_group();
+		if (group.group_focused && !node->is_root()) {
+			node->forEachNode([&](Hy3Node& child) { region.push_back(&child); });
+			return;
+		}
+
+		region.push_back(node);
+		node = group.focused_child;
+	}
+}
+
 void Hy3Node::markFocused() {
 	auto* root = this->root();
 
+	// only nodes whose focus state may change get their decorations and tab bars updated
+	std::vector<Hy3Node*> region;
+	collectFocusRegion(*root, region);
+
 	// update focus
 	if (this->is_group()) {
 		markGroupFocusedRecursive(this->as_group());
 	}
 
+	auto below_changed = false;
 	for (auto& ancestor: this->ancestors()) {
 		auto& group = ancestor.parent->as_group();
+		auto changed = group.focused_child != &ancestor || group.group_focused;
+		below_changed = below_changed || changed;
+
+		// focus only affects the geometry of tab groups and of expansions, which
+		// follow the focus through any stacked expansions below them
+		if ((changed && group.isTab())
+		    || (below_changed && group.expand_focused != ExpandFocusType::NotExpanded))
+			group.markDirty();
+
 		group.focused_child = &ancestor;
 		group.group_focused = false;
 	}
 
-	root->updateDecos();
+	root->algo->invalidateFocusCache();
+
+	collectFocusRegion(*root, region);
+	std::ranges::sort(region);
+	auto [first, last] = std::ranges::unique(region);
+	region.erase(first, last);
+
+	for (auto* node: region) {
+		if (node->is_target()) node->as_window()->updateDecorationValues();
+		else node->updateTabBar();
+	}
+
+	auto& stats = root->algo->focus_stats;
+	stats.changes++;
+	stats.last_touched = region.size();
+	stats.total_touched += region.size();
 }
 
 Hy3Node& Hy3Node::getFocusedNode(bool ignore_group_focus, bool stop_at_expanded) {
@@ -322,7 +545,15 @@ Hy3Node& Hy3Node::getPlacementActor() {
 	return *this;
 }
 
-void Hy3Node::recalcSizePosRecursive(CBox offsets, bool no_animation) {
+void Hy3Node::markDirty() {
+	this->dirty = true;
+
+	for (auto* node = this->parent.get(); node != nullptr && !node->child_dirty; node = node->parent.get()) {
+		node->child_dirty = true;
+	}
+}
+
+void Hy3Node::recalcSizePosRecursive(CBox offsets, Hy3RecalcContext& ctx) {
 	// clang-format off
 	static const auto p_gaps_in = ConfigValue<Hyprlang::CUSTOMTYPE, CCssGapData>("general:gaps_in");
 	static const auto tab_bar_height = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:height");
@@ -330,6 +561,18 @@ void Hy3Node::recalcSizePosRecursive(CBox offsets, bool no_animation) {
 	static const auto group_inset = ConfigValue<Hyprlang::INT>("plugin:hy3:group_inset");
 	// clang-format on
 
+	auto& last = this->last_recalc;
+	if (!ctx.force && !this->dirty && !this->child_dirty && last.valid
+	    && last.visualBox == this->visualBox && last.offsets == offsets && last.hidden == this->hidden)
+		return;
+
+	ctx.visited++;
+	last = {.visualBox = this->visualBox, .offsets = offsets, .hidden = this->hidden, .valid = true};
+	this->dirty = false;
+	this->child_dirty = false;
+
+	auto no_animation = ctx.no_animation;
+
 	this->logicalBox = CBox(
 	    this->visualBox.x - offsets.x, this->visualBox.y - offsets.y,
 	    this->visualBox.w + offsets.x + offsets.w, this->visualBox.h + offsets.y + offsets.h
@@ -337,9 +580,32 @@ void Hy3Node::recalcSizePosRecursive(CBox offsets, bool no_animation) {
 
 	// Keep in sync with WindowTarget::updatePos
 	if (this->is_target()) {
-		this->as_window()->setHidden(this->hidden);
-		this->as_target()->setPositionGlobal({.logicalBox = this->logicalBox, .visualBox = this->visualBox});
-		if (no_animation) this->as_target()->warpPositionSize();
+		auto& committed = this->as<Hy3TargetNode>().committed;
+		if (ctx.force) committed.valid = false;
+
+		// only push what changed, anything else restarts animations and damages the window
+		if (!committed.valid || committed.hidden != this->hidden) {
+			this->as_window()->setHidden(this->hidden);
+		}
+
+		if (!committed.valid || committed.logicalBox != this->logicalBox
+		    || committed.visualBox != this->visualBox)
+		{
+			this->as_target()->setPositionGlobal({.logicalBox = this->logicalBox, .visualBox = this->visualBox});
+			if (no_animation) this->as_target()->warpPositionSize();
+		}
+
+		committed = {
+		    .logicalBox = this->logicalBox,
+		    .visualBox = this->visualBox,
+		    .hidden = this->hidden,
+		    .valid = true,
+		};
+
+		if (ctx.layout != nullptr) {
+			if (this->hidden) ctx.layout->spatial_index.remove(this);
+			else ctx.layout->spatial_index.update(this, this->visualBox);
+		}
 		return;
 	}
 
@@ -375,13 +641,18 @@ void Hy3Node::recalcSizePosRecursive(CBox offsets, bool no_animation) {
 			    (uintptr_t) this
 			);
 			errorNotif();
+
+			// Children were not visited and keep their dirty state. Stay dirty, with
+			// ancestors marked again, so the next pass reaches them.
+			last.valid = false;
+			this->markDirty();
 			return;
 		}
 
 		expanded_node->visualBox = CBox(tpos, tsize);
 		expanded_node->setHidden(this->hidden);
 
-		expanded_node->recalcSizePosRecursive(offsets, no_animation);
+		expanded_node->recalcSizePosRecursive(offsets, ctx);
 	}
 
 	// Compute constraint for splits: total visible space minus inter-child gaps
@@ -427,7 +698,7 @@ void Hy3Node::recalcSizePosRecursive(CBox offsets, bool no_animation) {
 			double child_w = child->size_ratio * ratio_mul;
 
 			child->visualBox = CBox(tpos.x + offset, tpos.y, child_w - inset, tsize.y);
-			child->hidden = this->hidden || expand_focused;
+			child->updateHidden(this->hidden || expand_focused);
 
 			child_offsets.x = is_first ? offsets.x : gaps_in.m_left;
 			child_offsets.w = (is_last ? offsets.w : gaps_in.m_right) + inset;
@@ -437,14 +708,14 @@ void Hy3Node::recalcSizePosRecursive(CBox offsets, bool no_animation) {
 			offset += child_w;
 			if (!is_last) offset += inter_gap;
 
-			child->recalcSizePosRecursive(child_offsets, no_animation);
+			child->recalcSizePosRecursive(child_offsets, ctx);
 			break;
 		}
 		case Hy3GroupLayout::SplitV: {
 			double child_h = child->size_ratio * ratio_mul;
 
 			child->visualBox = CBox(tpos.x, tpos.y + offset, tsize.x, child_h - inset);
-			child->hidden = this->hidden || expand_focused;
+			child->updateHidden(this->hidden || expand_focused);
 
 			child_offsets.y = (is_first ? offsets.y : gaps_in.m_top) + inset;
 			child_offsets.h = is_last ? offsets.h : gaps_in.m_bottom;
@@ -454,14 +725,14 @@ void Hy3Node::recalcSizePosRecursive(CBox offsets, bool no_animation) {
 			offset += child_h;
 			if (!is_last) offset += inter_gap;
 
-			child->recalcSizePosRecursive(child_offsets, no_animation);
+			child->recalcSizePosRecursive(child_offsets, ctx);
 			break;
 		}
 		case Hy3GroupLayout::Tabbed: {
 			double tab_offset = (double)*tab_bar_height + (double)*tab_bar_padding;
 
 			child->visualBox = CBox(tpos.x, tpos.y + tab_offset, tsize.x, tsize.y - tab_offset);
-			child->hidden = this->hidden || expand_focused || group.focused_child != child.get();
+			child->updateHidden(this->hidden || expand_focused || group.focused_child != child.get());
 
 			// Tab bar makes child non-edge on top
 			child_offsets.x = offsets.x;
@@ -469,13 +740,13 @@ void Hy3Node::recalcSizePosRecursive(CBox offsets, bool no_animation) {
 			child_offsets.w = offsets.w;
 			child_offsets.h = offsets.h;
 
-			child->recalcSizePosRecursive(child_offsets, no_animation);
+			child->recalcSizePosRecursive(child_offsets, ctx);
 			break;
 		}
 		case Hy3GroupLayout::Root: {
 			child->visualBox = CBox(tpos, tsize);
-			child->hidden = this->hidden;
-			child->recalcSizePosRecursive(offsets, no_animation);
+			child->updateHidden(this->hidden);
+			child->recalcSizePosRecursive(offsets, ctx);
 			break;
 		}
 		}
@@ -487,17 +758,19 @@ void Hy3Node::recalcSizePosRecursive(CBox offsets, bool no_animation) {
 // Find the visible window with the highest z-order in this subtree.
 static CWindow* findTopVisibleWindow(Hy3Node& node) {
 	CWindow* result = nullptr;
-	auto& compositor_windows = g_pCompositor->m_windows;
-	auto it = compositor_windows.begin();
-	for (auto& window: node.windows(true)) {
-		for (auto search = it; search != compositor_windows.end(); ++search) {
-			if (search->get() == &window) {
-				result = &window;
-				it = search;
-				break;
-			}
-		}
-	}
+	auto result_rank = Hy3ZOrder::UNKNOWN;
+
+	node.forEachWindow(
+	    [&](CWindow& window) {
+		    auto rank = g_zOrder.rank(&window);
+		    if (result == nullptr || rank > result_rank) {
+			    result = &window;
+			    result_rank = rank;
+		    }
+	    },
+	    true
+	);
+
 	return result;
 }
 
@@ -505,6 +778,11 @@ void Hy3Node::updateTabBar(bool no_animation) {
 	if (this->type() == Hy3NodeType::Group) {
 		auto& group = this->as_group();
 
+		auto* layout = this->layout();
+		if (layout != nullptr && layout->deferTabBarUpdate(group, no_animation)) return;
+
+		if (layout != nullptr) layout->invalidateTabBarIndex();
+
 		if (group.isTab()) {
 			if (!group.tab_bar) group.tab_bar = Hy3TabGroup::create(*this);
 			group.tab_bar->updateWithGroup(*this, no_animation);
@@ -524,20 +802,6 @@ void Hy3Node::updateTabBarRecursive() {
 	}
 }
 
-void Hy3Node::updateDecos() {
-	switch (this->type()) {
-	case Hy3NodeType::Target:
-		this->as_window()->updateDecorationValues();
-		break;
-	case Hy3NodeType::Group:
-		for (auto& child: this->as_group().children) {
-			child->updateDecos();
-		}
-
-		this->updateTabBar();
-	}
-}
-
 std::string Hy3Node::getTitle() {
 	switch (this->type()) {
 	case Hy3NodeType::Target: return this->as_window()->m_title;
@@ -564,16 +828,47 @@ std::string Hy3Node::getTitle() {
 	return "";
 }
 
-bool Hy3Node::isUrgent() {
-	for (auto& window: this->windows()) {
-		if (window.m_isUrgent) return true;
+bool Hy3Node::isUrgent() { return this->counts.urgent != 0; }
+
+void Hy3TargetNode::refreshUrgent() {
+	auto window = this->as_window();
+	auto urgent = window && window->m_isUrgent;
+	if (urgent == (this->counts.urgent != 0)) return;
+
+	this->adjustCounts({.urgent = 1}, !urgent);
+}
+
+Hy3NodeCounts& Hy3NodeCounts::operator+=(const Hy3NodeCounts& rhs) {
+	this->windows += rhs.windows;
+	this->urgent += rhs.urgent;
+	this->visible += rhs.visible;
+	return *this;
+}
+
+Hy3NodeCounts& Hy3NodeCounts::operator-=(const Hy3NodeCounts& rhs) {
+	this->windows -= rhs.windows;
+	this->urgent -= rhs.urgent;
+	this->visible -= rhs.visible;
+	return *this;
+}
+
+void Hy3Node::adjustCounts(const Hy3NodeCounts& delta, bool subtract) {
+	for (auto* node = this; node != nullptr; node = node->parent.get()) {
+		if (subtract) node->counts -= delta;
+		else node->counts += delta;
 	}
-	return false;
 }
 
-void Hy3Node::setHidden(bool hidden) {
+void Hy3Node::updateHidden(bool hidden) {
+	if (this->hidden == hidden) return;
 	this->hidden = hidden;
 
+	if (this->is_target()) this->adjustCounts({.visible = 1}, hidden);
+}
+
+void Hy3Node::setHidden(bool hidden) {
+	this->updateHidden(hidden);
+
 	if (this->is_group()) {
 		for (auto& child: this->as_group().children) {
 			child->setHidden(hidden);
@@ -599,45 +894,13 @@ Hy3Node* Hy3Node::findNodeForTabGroup(Hy3TabGroup& tab_group) {
 	return nullptr;
 }
 
-std::generator<Hy3Node&> Hy3Node::ancestors() {
-	auto* node = this;
-	while (!node->is_root()) {
-		co_yield *node;
-		node = node->parent.get();
-	}
-}
-
-std::generator<CWindow&> Hy3Node::windows(bool visibleOnly) {
-	if (this->is_target()) {
-		co_yield *this->as_window();
-	} else {
-		auto& group = this->as_group();
-		if (visibleOnly
-		    && (group.isTab()
-		        || group.expand_focused != ExpandFocusType::NotExpanded))
-		{
-			if (group.focused_child != nullptr) {
-				for (auto& window: group.focused_child->windows(true)) {
-					co_yield window;
-				}
-			}
-		} else {
-			for (auto& child: group.children) {
-				for (auto& window: child->windows(visibleOnly)) {
-					co_yield window;
-				}
-			}
-		}
-	}
-}
-
-
 std::string Hy3Node::debugNode() {
 	std::stringstream buf;
 	std::string addr = "0x" + std::to_string((size_t) this);
 	switch (this->type()) {
 	case Hy3NodeType::Target:
 		buf << "window(" << this << " of " << this->parent.get() << ") [hypr " << this->as_window().get() << "] size ratio: " << this->size_ratio;
+		if (this->counts.urgent != 0) buf << ", urgent";
 		break;
 	case Hy3NodeType::Group:
 		buf << "group(" << this << " of " << this->parent.get() << ") [";
@@ -657,6 +920,8 @@ std::string Hy3Node::debugNode() {
 
 		buf << "] size ratio: ";
 		buf << this->size_ratio;
+		buf << ", windows: " << this->counts.windows << " (" << this->counts.visible << " visible, "
+		    << this->counts.urgent << " urgent)";
 
 		if (group.expand_focused != ExpandFocusType::NotExpanded) {
 			buf << ", has-expanded";
@@ -721,9 +986,8 @@ static void collapseSingleParentInternal(Hy3Node* into) {
 	    (uintptr_t) intoGroup.children.front().get()
 	);
 
-	auto childUp = intoGroup.extractChildRaw(intoGroup.children.begin());
-	auto* child = childUp.get();
-	auto old = parentGroup.replaceChild(it, std::move(childUp));
+	auto* child = intoGroup.children.front().get();
+	auto old = parentGroup.collapseChild(it);
 
 	// HACK: steal titlebar from parent if we have a new node, prevents visual issues if rewrapped
 	if (child->is_group() && old->as_group().isTab() && child->as_group().isTab()) {
@@ -794,7 +1058,7 @@ UP<Hy3Node> Hy3Node::extractAndMerge(
 }
 
 void Hy3Node::insertAndMerge(
-    std::list<UP<Hy3Node>>::iterator pos,
+    std::vector<UP<Hy3Node>>::iterator pos,
     UP<Hy3Node> child,
     CollapsePolicy policy
 ) {
@@ -819,7 +1083,8 @@ void Hy3Node::wrap(Hy3GroupLayout layout, GroupEphemeralityOption ephemeral, boo
 
 	auto it = parentGroup.findChild(*this);
 
-	auto group_up = Hy3Node::create(layout);
+	auto* hy3 = this->layout();
+	auto group_up = Hy3Node::create(layout, hy3 ? hy3->nodePool() : nullptr);
 	auto& group_node = *group_up;
 
 	auto this_up = parentGroup.replaceChild(it, std::move(group_up));
@@ -828,6 +1093,7 @@ void Hy3Node::wrap(Hy3GroupLayout layout, GroupEphemeralityOption ephemeral, boo
 	group.insertChild(std::move(this_up));
 	group.group_focused = false;
 	group.focused_child = this;
+	if (hy3 != nullptr) hy3->invalidateFocusCache();
 	if (ephemeral == GroupEphemeralityOption::Ephemeral
 	    || ephemeral == GroupEphemeralityOption::ForceEphemeral)
 		group.setEphemeral(GroupEphemeralityOption::ForceEphemeral);
@@ -919,6 +1185,8 @@ void Hy3Node::resize(ShiftDirection direction, double delta, bool no_animation)
 	if (containing_group.isSplit()
 	    && getAxis(direction) == getAxis(containing_group.layout))
 	{
+		if (auto* layout = this->layout()) layout->flushGeometry();
+
 		double parent_size =
 		    getAxis(direction) == Axis::Horizontal ? parent_node->visualBox.w : parent_node->visualBox.h;
 		auto ratio_mod = delta * (float) containing_group.children.size() / parent_size;
@@ -942,6 +1210,7 @@ void Hy3Node::resize(ShiftDirection direction, double delta, bool no_animation)
 				if (requested_size_ratio >= MIN_RATIO && requested_neighbor_size_ratio >= MIN_RATIO) {
 					this->size_ratio = requested_size_ratio;
 					neighbor->size_ratio = requested_neighbor_size_ratio;
+					parent_node->markDirty();
 
 					this->layout()->recalcGeometry(no_animation);
 				}
@@ -6,15 +6,36 @@ struct Hy3GroupNode;
 struct Hy3RootNode;
 enum class Hy3GroupLayout;
 
-#include <generator>
+#include <cstdint>
+#include <iterator>
+#include <type_traits>
+#include <typeinfo>
+#include <vector>
 
 #include <hyprland/src/defines.hpp>
 #include <hyprland/src/desktop/view/Window.hpp>
 #include <hyprland/src/layout/target/Target.hpp>
 
 #include "Hy3Layout.hpp"
+#include "NodePool.hpp"
 #include "TabGroup.hpp"
 
+// Walks from a node up to, but not including, the root. Allocation free.
+struct Hy3AncestorRange {
+	struct iterator {
+		Hy3Node* node;
+
+		Hy3Node& operator*() const { return *this->node; }
+		iterator& operator++();
+		bool operator==(std::default_sentinel_t) const;
+	};
+
+	Hy3Node* start;
+
+	iterator begin() const { return {this->start}; }
+	std::default_sentinel_t end() const { return {}; }
+};
+
 enum class Hy3GroupLayout {
 	Root,
 	SplitH,
@@ -45,6 +66,24 @@ enum class CollapsePolicy {
 	SingleNodeGroups,
 };
 
+// Window totals for a subtree, kept current by Hy3GroupNode's child mutators.
+struct Hy3NodeCounts {
+	size_t windows = 0;
+	size_t urgent = 0;
+	size_t visible = 0;
+
+	Hy3NodeCounts& operator+=(const Hy3NodeCounts&);
+	Hy3NodeCounts& operator-=(const Hy3NodeCounts&);
+};
+
+// Per-pass state for Hy3Node::recalcSizePosRecursive.
+struct Hy3RecalcContext {
+	bool no_animation = false;
+	bool force = false; // recompute every node regardless of dirty state
+	Hy3Layout* layout = nullptr; // receives committed target boxes in its spatial index
+	size_t visited = 0;
+};
+
 struct Hy3Node {
 	WP<Hy3Node> parent;
 	WP<Hy3Node> self; // set from owning UP at creation time
@@ -52,14 +91,51 @@ struct Hy3Node {
 	CBox visualBox;
 	float size_ratio = 1.0;
 	bool hidden = false;
+	size_t child_index = 0; // position in parent->children, maintained by Hy3GroupNode
+	Hy3NodeCounts counts;
+
+	// Euler tour interval of this node within the tree of `label_root`. Nested
+	// intervals mean nested nodes, giving O(1) ancestry and document order checks.
+	// Unset (null label_root) while detached from a root.
+	Hy3Node* label_root = nullptr;
+	uint64_t label_enter = 0;
+	uint64_t label_exit = 0;
+
+	// `dirty` is set when this node's own layout inputs (children, ratios, layout,
+	// expansion, tab focus) change, and `child_dirty` on every ancestor of a dirty
+	// node. Clean subtrees whose box, offsets and hidden state match the last pass
+	// are skipped by recalcSizePosRecursive.
+	bool dirty = true;
+	bool child_dirty = false;
+	struct {
+		CBox visualBox;
+		CBox offsets;
+		bool hidden = false;
+		bool valid = false;
+	} last_recalc;
 
 	virtual ~Hy3Node() = default;
 	Hy3Node(const Hy3Node&) = delete;
 	Hy3Node& operator=(const Hy3Node&) = delete;
 
-	template<typename T> bool is() const { return dynamic_cast<const T*>(this) != nullptr; }
-	template<typename T> T& as() { return dynamic_cast<T&>(*this); }
-	template<typename T> const T& as() const { return dynamic_cast<const T&>(*this); }
+	// Checked downcasts against the stored node kind. No RTTI involved.
+	template<typename T> bool is() const {
+		if constexpr (std::is_same_v<T, Hy3Node>) return true;
+		else if constexpr (std::is_same_v<T, Hy3TargetNode>) return this->kind == Hy3NodeType::Target;
+		else if constexpr (std::is_same_v<T, Hy3GroupNode>) return this->kind == Hy3NodeType::Group;
+		else if constexpr (std::is_same_v<T, Hy3RootNode>) return this->is_root();
+		else static_assert(false, "not a Hy3Node type");
+	}
+
+	template<typename T> T& as() {
+		if (!this->is<T>()) throw std::bad_cast();
+		return static_cast<T&>(*this);
+	}
+
+	template<typename T> const T& as() const {
+		if (!this->is<T>()) throw std::bad_cast();
+		return static_cast<const T&>(*this);
+	}
 
 	bool valid() const;
 	Hy3NodeType type() const;
@@ -70,14 +146,23 @@ struct Hy3Node {
 	PHLWINDOW as_window();
 
 	bool operator==(const Hy3Node&) const;
-	bool is_root();
+	bool is_root() const;
+	// True if this node comes before `other` in a depth-first walk of their tree.
+	// False if they are not in the same tree.
+	bool precedes(const Hy3Node& other) const;
 	bool is_root_group();
 	void assertNotRoot();
 	Hy3RootNode* root();
 	Hy3Layout* layout();
 
-	static UP<Hy3Node> create(SP<Layout::ITarget> target);
-	static UP<Hy3Node> create(Hy3GroupLayout group_layout);
+	// Nodes are allocated from `pool` when given, otherwise from the heap.
+	static UP<Hy3Node> create(SP<Layout::ITarget> target, Hy3NodePool* pool = nullptr);
+	static UP<Hy3Node> create(Hy3GroupLayout group_layout, Hy3NodePool* pool = nullptr);
+
+	static void* operator new(size_t size);
+	static void* operator new(size_t size, Hy3NodePool& pool);
+	static void operator delete(void* ptr);
+	static void operator delete(void* ptr, Hy3NodePool& pool);
 
 	void focus(bool warp, Desktop::eFocusReason reason);
 	void markFocused();
@@ -89,18 +174,30 @@ struct Hy3Node {
 	Hy3Node& getExpandActor();
 	Hy3Node& getPlacementActor();
 
-	void recalcSizePosRecursive(CBox offsets, bool no_animation = false);
+	void markDirty();
+	void recalcSizePosRecursive(CBox offsets, Hy3RecalcContext& ctx);
 	void updateTabBar(bool no_animation = false);
 	void updateTabBarRecursive();
-	void updateDecos();
 
 	std::string getTitle();
 	bool isUrgent();
 	void setHidden(bool);
+	// Set this node's own hidden flag, updating visible counts if it changed.
+	void updateHidden(bool);
+	// Apply `delta` to the counts of this node and all of its ancestors.
+	void adjustCounts(const Hy3NodeCounts& delta, bool subtract = false);
 
 	Hy3Node* findNodeForTabGroup(Hy3TabGroup&);
-	std::generator<Hy3Node&> ancestors();
-	std::generator<Desktop::View::CWindow&> windows(bool visibleOnly = false);
+	Hy3AncestorRange ancestors() { return {this}; }
+
+	// Calls `fn` with each window of the subtree in tree order. If `fn` returns bool,
+	// returning true stops the walk, and forEachWindow returns true as well.
+	// With `visibleOnly`, tabbed and expanded groups only visit their focused child.
+	template <typename F>
+	bool forEachWindow(F&& fn, bool visibleOnly = false);
+	// Call fn on this node and every node below it.
+	template <typename F>
+	void forEachNode(F&& fn);
 	std::string debugNode();
 
 	Hy3Node* collapseParents(CollapsePolicy policy);
@@ -111,7 +208,7 @@ struct Hy3Node {
 	);
 
 	void insertAndMerge(
-	    std::list<UP<Hy3Node>>::iterator pos,
+	    std::vector<UP<Hy3Node>>::iterator pos,
 	    UP<Hy3Node> child,
 	    CollapsePolicy policy = CollapsePolicy::EmptySplits
 	);
@@ -120,17 +217,33 @@ struct Hy3Node {
 	void wrap(Hy3GroupLayout, GroupEphemeralityOption, bool change = true);
 
 protected:
-	Hy3Node() = default;
+	Hy3Node(Hy3NodeType kind): kind(kind) {}
+
+private:
+	const Hy3NodeType kind;
 };
 
 struct Hy3TargetNode : Hy3Node {
 	WP<Layout::ITarget> target;
+
+	// Geometry and visibility last pushed to the window by recalcSizePosRecursive.
+	struct {
+		CBox logicalBox;
+		CBox visualBox;
+		bool hidden = false;
+		bool valid = false;
+	} committed;
+
+	Hy3TargetNode(): Hy3Node(Hy3NodeType::Target) {}
+
+	// Re-read the window's urgency and propagate any change to the ancestors.
+	void refreshUrgent();
 };
 
 struct Hy3GroupNode : Hy3Node {
 	Hy3GroupLayout layout = Hy3GroupLayout::SplitH;
 	Hy3GroupLayout previous_nontab_layout = Hy3GroupLayout::SplitH;
-	std::list<UP<Hy3Node>> children;
+	std::vector<UP<Hy3Node>> children;
 	bool group_focused = true;
 	Hy3Node* focused_child = nullptr; // non-owning observer, always valid while parent group lives
 	ExpandFocusType expand_focused = ExpandFocusType::NotExpanded;
@@ -138,6 +251,9 @@ struct Hy3GroupNode : Hy3Node {
 	bool locked = false;
 	bool containment = false;
 	Hy3TabGroupWrapper tab_bar;
+	// set while queued in Hy3Layout::pending
+	bool tab_bar_queued = false;
+	bool tab_bar_no_animation = false;
 
 	Hy3GroupNode(Hy3GroupLayout layout);
 	~Hy3GroupNode() override = default;
@@ -150,18 +266,74 @@ struct Hy3GroupNode : Hy3Node {
 	void setLayout(Hy3GroupLayout layout);
 	void setEphemeral(GroupEphemeralityOption ephemeral);
 
-	auto findChild(Hy3Node& child) -> std::list<UP<Hy3Node>>::iterator;
-	void insertChild(std::list<UP<Hy3Node>>::iterator pos, UP<Hy3Node> child);
+	auto findChild(Hy3Node& child) -> std::vector<UP<Hy3Node>>::iterator;
+	void insertChild(std::vector<UP<Hy3Node>>::iterator pos, UP<Hy3Node> child);
 	void insertChild(UP<Hy3Node> child);
-	UP<Hy3Node> extractChildRaw(std::list<UP<Hy3Node>>::iterator it);
+	UP<Hy3Node> extractChildRaw(std::vector<UP<Hy3Node>>::iterator it);
 	UP<Hy3Node> extractChildRaw(Hy3Node& child);
-	UP<Hy3Node> replaceChild(std::list<UP<Hy3Node>>::iterator it, UP<Hy3Node> replacement);
+	UP<Hy3Node> replaceChild(std::vector<UP<Hy3Node>>::iterator it, UP<Hy3Node> replacement);
 	UP<Hy3Node> extractChild(Hy3Node& child);
+	// Replace the single-child group at `it` with its only child, keeping the child's
+	// place in the layout. Returns the emptied group.
+	UP<Hy3Node> collapseChild(std::vector<UP<Hy3Node>>::iterator it);
+	// Move the child at `from` to directly before `to`.
+	void moveChild(std::vector<UP<Hy3Node>>::iterator from, std::vector<UP<Hy3Node>>::iterator to);
 
 	friend struct Hy3Node;
+
+private:
+	void reindexChildren(size_t from, size_t to);
+	// Give the subtree at children[index] labels between its neighbors.
+	void labelChild(size_t index);
 };
 
 struct Hy3RootNode : Hy3GroupNode {
 	Hy3Layout* algo = nullptr;
 	Hy3RootNode(Hy3Layout* layout);
 };
+
+inline Hy3AncestorRange::iterator& Hy3AncestorRange::iterator::operator++() {
+	this->node = this->node->parent.get();
+	return *this;
+}
+
+inline bool Hy3AncestorRange::iterator::operator==(std::default_sentinel_t) const {
+	return this->node == nullptr || this->node->is_root();
+}
+
+template <typename F>
+void Hy3Node::forEachNode(F&& fn) {
+	fn(*this);
+
+	if (this->is_group()) {
+		for (auto& child: static_cast<Hy3GroupNode&>(*this).children) {
+			child->forEachNode(fn);
+		}
+	}
+}
+
+template <typename F>
+bool Hy3Node::forEachWindow(F&& fn, bool visibleOnly) {
+	if (this->is_target()) {
+		auto& window = *this->as_window();
+
+		if constexpr (std::is_same_v<std::invoke_result_t<F&, Desktop::View::CWindow&>, bool>) {
+			return fn(window);
+		} else {
+			fn(window);
+			return false;
+		}
+	}
+
+	auto& group = static_cast<Hy3GroupNode&>(*this);
+
+	if (visibleOnly && (group.isTab() || group.expand_focused != ExpandFocusType::NotExpanded)) {
+		return group.focused_child != nullptr && group.focused_child->forEachWindow(fn, true);
+	}
+
+	for (auto& child: group.children) {
+		if (child->forEachWindow(fn, visibleOnly)) return true;
+	}
+
+	return false;
+}
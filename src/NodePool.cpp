@@ -0,0 +1,97 @@
+#include "NodePool.hpp"
+
+#include <cstddef>
+#include <new>
+
+namespace {
+
+// Stored directly in front of every node allocation.
+struct alignas(std::max_align_t) SlotHeader {
+	Hy3NodePool* pool;
+	size_t slot_size;
+};
+
+constexpr size_t SLOTS_PER_SLAB = 32;
+
+constexpr size_t slotSizeFor(size_t size) {
+	constexpr auto align = alignof(std::max_align_t);
+	return sizeof(SlotHeader) + (size + align - 1) / align * align;
+}
+
+} // namespace
+
+Hy3NodePool* Hy3NodePool::create() { return new Hy3NodePool(); }
+
+Hy3NodePool::~Hy3NodePool() {
+	for (auto* slab: this->slabs) {
+		::operator delete(slab);
+	}
+}
+
+void Hy3NodePool::release() {
+	this->released = true;
+	if (this->live == 0) delete this;
+}
+
+Hy3NodePool::SizeClass& Hy3NodePool::sizeClass(size_t slot_size) {
+	for (auto& size_class: this->classes) {
+		if (size_class.slot_size == slot_size) return size_class;
+	}
+
+	return this->classes.emplace_back(SizeClass {.slot_size = slot_size, .free = {}});
+}
+
+void Hy3NodePool::refill(SizeClass& size_class) {
+	auto* slab = static_cast<std::byte*>(::operator new(size_class.slot_size * SLOTS_PER_SLAB));
+	this->slabs.push_back(slab);
+
+	// hand out slots from the front of the slab first
+	for (auto i = SLOTS_PER_SLAB; i > 0; i--) {
+		size_class.free.push_back(slab + (i - 1) * size_class.slot_size);
+	}
+}
+
+void* Hy3NodePool::allocate(size_t size) {
+	auto& size_class = this->sizeClass(slotSizeFor(size));
+	if (size_class.free.empty()) this->refill(size_class);
+
+	auto* slot = size_class.free.back();
+	size_class.free.pop_back();
+	this->live++;
+
+	auto* header = new (slot) SlotHeader {.pool = this, .slot_size = size_class.slot_size};
+	return header + 1;
+}
+
+void* Hy3NodePool::allocateUnpooled(size_t size) {
+	auto* slot = ::operator new(slotSizeFor(size));
+	auto* header = new (slot) SlotHeader {.pool = nullptr, .slot_size = slotSizeFor(size)};
+	return header + 1;
+}
+
+void Hy3NodePool::deallocate(void* ptr) {
+	if (ptr == nullptr) return;
+
+	auto* header = static_cast<SlotHeader*>(ptr) - 1;
+	auto* pool = header->pool;
+
+	if (pool == nullptr) {
+		::operator delete(header);
+		return;
+	}
+
+	pool->sizeClass(header->slot_size).free.push_back(header);
+	pool->live--;
+
+	if (pool->released && pool->live == 0) delete pool;
+}
+
+Hy3NodePool::Stats Hy3NodePool::stats() const {
+	Stats stats {.live = this->live, .free = 0, .slabs = this->slabs.size()};
+
+	for (auto& size_class: this->classes) {
+		stats.free += size_class.free.size();
+	}
+
+	return stats;
+}
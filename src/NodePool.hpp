@@ -0,0 +1,47 @@
+#pragma once
+
+#include <cstddef>
+#include <vector>
+
+// Slab allocator backing Hy3Node storage for a single layout.
+//
+// Nodes can outlive the layout that allocated them (e.g. when moved to another
+// workspace), so the owning layout only releases the pool, and the pool frees
+// itself once released and empty.
+class Hy3NodePool {
+public:
+	struct Stats {
+		size_t live = 0;
+		size_t free = 0;
+		size_t slabs = 0;
+	};
+
+	static Hy3NodePool* create();
+	void release();
+
+	void* allocate(size_t size);
+	// Frees memory returned by allocate() or allocateUnpooled(), whichever pool it came from.
+	static void deallocate(void* ptr);
+	static void* allocateUnpooled(size_t size);
+
+	Stats stats() const;
+
+private:
+	struct SizeClass {
+		size_t slot_size;
+		std::vector<void*> free;
+	};
+
+	std::vector<SizeClass> classes;
+	std::vector<void*> slabs;
+	size_t live = 0;
+	bool released = false;
+
+	Hy3NodePool() = default;
+	~Hy3NodePool();
+	Hy3NodePool(const Hy3NodePool&) = delete;
+	Hy3NodePool& operator=(const Hy3NodePool&) = delete;
+
+	SizeClass& sizeClass(size_t slot_size);
+	void refill(SizeClass&);
+};
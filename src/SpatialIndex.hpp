@@ -0,0 +1,161 @@
+#pragma once
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <limits>
+#include <unordered_map>
+#include <vector>
+
+#include <hyprland/src/helpers/math/Math.hpp>
+
+// Uniform grid over item boxes, for finding items in an area without walking
+// every item. Items are keyed by pointer and may span several cells.
+template <typename T>
+class Hy3SpatialGrid {
+public:
+	explicit Hy3SpatialGrid(double cell_size = 256.0): cell_size(cell_size) {}
+
+	// Insert an item or move it to a new box.
+	void update(T* item, const CBox& box) {
+		auto it = this->items.find(item);
+		if (it != this->items.end()) {
+			if (it->second == box) return;
+			this->unlink(item, it->second);
+			it->second = box;
+		} else {
+			this->items.emplace(item, box);
+		}
+
+		this->link(item, box);
+	}
+
+	void remove(T* item) {
+		auto it = this->items.find(item);
+		if (it == this->items.end()) return;
+
+		this->unlink(item, it->second);
+		this->items.erase(it);
+
+		if (this->items.empty()) this->clear();
+	}
+
+	void clear() {
+		this->cells.clear();
+		this->items.clear();
+		this->min_cx = this->min_cy = std::numeric_limits<int32_t>::max();
+		this->max_cx = this->max_cy = std::numeric_limits<int32_t>::min();
+	}
+
+	bool empty() const { return this->items.empty(); }
+	size_t size() const { return this->items.size(); }
+	double cellSize() const { return this->cell_size; }
+
+	// Box covering every item. May be larger than needed after removals.
+	CBox bounds() const {
+		if (this->items.empty()) return CBox();
+
+		return CBox(
+		    this->min_cx * this->cell_size,
+		    this->min_cy * this->cell_size,
+		    (this->max_cx - this->min_cx + 1) * this->cell_size,
+		    (this->max_cy - this->min_cy + 1) * this->cell_size
+		);
+	}
+
+	// Call fn(T*, const CBox&) once for each item overlapping `area`.
+	template <typename F>
+	void query(const CBox& area, F&& fn) const {
+		if (this->items.empty()) return;
+
+		auto x0 = std::max(this->cellOf(area.x), this->min_cx);
+		auto y0 = std::max(this->cellOf(area.y), this->min_cy);
+		auto x1 = std::min(this->cellOf(area.x + area.w), this->max_cx);
+		auto y1 = std::min(this->cellOf(area.y + area.h), this->max_cy);
+
+		for (auto cy = y0; cy <= y1; cy++) {
+			for (auto cx = x0; cx <= x1; cx++) {
+				auto cell = this->cells.find(key(cx, cy));
+				if (cell == this->cells.end()) continue;
+
+				for (auto* item: cell->second) {
+					auto& box = this->items.at(item);
+					if (!overlaps(box, area)) continue;
+
+					// Report each item only from the cell holding the top left corner of
+					// its overlap with `area`, so items spanning several cells come up once.
+					if (this->cellOf(std::max(box.x, area.x)) != cx
+					    || this->cellOf(std::max(box.y, area.y)) != cy)
+						continue;
+
+					fn(item, box);
+				}
+			}
+		}
+	}
+
+private:
+	double cell_size;
+	std::unordered_map<uint64_t, std::vector<T*>> cells;
+	std::unordered_map<T*, CBox> items;
+
+	// Cell range touched by items since the grid was last empty. Only grows, which
+	// keeps queries bounded without rescanning on removal.
+	int32_t min_cx = std::numeric_limits<int32_t>::max();
+	int32_t min_cy = std::numeric_limits<int32_t>::max();
+	int32_t max_cx = std::numeric_limits<int32_t>::min();
+	int32_t max_cy = std::numeric_limits<int32_t>::min();
+
+	static bool overlaps(const CBox& a, const CBox& b) {
+		return a.x < b.x + b.w && b.x < a.x + a.w && a.y < b.y + b.h && b.y < a.y + a.h;
+	}
+
+	static uint64_t key(int32_t cx, int32_t cy) {
+		return (uint64_t(uint32_t(cx)) << 32) | uint32_t(cy);
+	}
+
+	int32_t cellOf(double v) const {
+		auto cell = std::floor(v / this->cell_size);
+		return int32_t(std::clamp(cell, -1e9, 1e9));
+	}
+
+	template <typename F>
+	void forEachCell(const CBox& box, F&& fn) {
+		auto x0 = this->cellOf(box.x);
+		auto y0 = this->cellOf(box.y);
+		auto x1 = this->cellOf(box.x + box.w);
+		auto y1 = this->cellOf(box.y + box.h);
+
+		for (auto cy = y0; cy <= y1; cy++) {
+			for (auto cx = x0; cx <= x1; cx++) {
+				fn(cx, cy);
+			}
+		}
+	}
+
+	void link(T* item, const CBox& box) {
+		this->forEachCell(box, [&](int32_t cx, int32_t cy) {
+			this->cells[key(cx, cy)].push_back(item);
+			this->min_cx = std::min(this->min_cx, cx);
+			this->min_cy = std::min(this->min_cy, cy);
+			this->max_cx = std::max(this->max_cx, cx);
+			this->max_cy = std::max(this->max_cy, cy);
+		});
+	}
+
+	void unlink(T* item, const CBox& box) {
+		this->forEachCell(box, [&](int32_t cx, int32_t cy) {
+			auto cell = this->cells.find(key(cx, cy));
+			if (cell == this->cells.end()) return;
+
+			auto& list = cell->second;
+			auto it = std::find(list.begin(), list.end(), item);
+			if (it != list.end()) {
+				*it = list.back();
+				list.pop_back();
+			}
+
+			if (list.empty()) this->cells.erase(cell);
+		});
+	}
+};
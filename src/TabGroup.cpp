@@ -1,9 +1,10 @@
 #include "TabGroup.hpp"
+#include <algorithm>
+#include <cmath>
 #include <optional>
 #include <utility>
 
 #include <GLES2/gl2.h>
-#include <cairo/cairo.h>
 #include <hyprgraphics/color/Color.hpp>
 #include <hyprland/src/Compositor.hpp>
 #include <hyprland/src/desktop/state/FocusState.hpp>
@@ -18,7 +19,6 @@
 #include <hyprutils/math/Box.hpp>
 #include <hyprutils/math/Region.hpp>
 #include <hyprutils/memory/SharedPtr.hpp>
-#include <pango/pangocairo.h>
 #include <pixman.h>
 
 #include "log.hpp"
@@ -160,6 +160,12 @@ void Hy3TabBarEntry::setMonitorActive(bool monitorActive) {
 	}
 }
 
+Hy3TabBarEntry::~Hy3TabBarEntry() {
+	// entries can outlive the atlas during unload, don't start a new one
+	auto* atlas = Hy3GlyphAtlas::existing();
+	if (atlas != nullptr && this->text_request != 0) atlas->cancel(this->text_request);
+}
+
 void Hy3TabBarEntry::beginDestroy() {
 	this->destroying = true;
 	*this->vertical_pos = 1.0;
@@ -176,14 +182,13 @@ bool Hy3TabBarEntry::shouldRemove() {
 	return this->destroying && (this->vertical_pos->value() == 1.0 || this->width->value() == 0.0);
 }
 
-void Hy3TabBarEntry::render(float scale, CBox& box, float opacity_mul) {
+void Hy3TabBarEntry::render(float scale, CBox& box, float opacity_mul, Hy3TabBatch& batch) {
 	auto opacity = opacity_mul * this->fade_opacity->value();
 
 	// clang-format off
 	static const auto s_radius = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:radius");
 	static const auto border_width = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:border_width");
 	static const auto s_opacity = ConfigValue<Hyprlang::FLOAT>("plugin:hy3:tabs:opacity");
-	static const auto blur = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:blur");
 	static const auto col_active = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:col.active");
 	static const auto col_border_active = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:col.active.border");
 	static const auto col_focused = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:col.focused");
@@ -214,23 +219,19 @@ void Hy3TabBarEntry::render(float scale, CBox& box, float opacity_mul) {
 
 	box.round();
 
-	// sometimes enabled before our renderer is called
-	g_pHyprOpenGL->scissor(nullptr);
-
-	Hy3Render::renderTab(
-	    box,
-	    opacity * *s_opacity,
-	    *blur,
-	    color,
-	    border_color,
-	    *border_width,
-	    radius
-	);
+	batch.tabs.push_back({
+	    .box = box,
+	    .fill_color = color,
+	    .border_color = border_color,
+	    .opacity = static_cast<float>(opacity * *s_opacity),
+	    .border_width = static_cast<int>(*border_width),
+	    .radius = static_cast<int>(radius),
+	});
 
-	this->renderText(scale, box, opacity);
+	this->renderText(scale, box, opacity, batch);
 }
 
-void Hy3TabBarEntry::renderText(float scale, CBox& box, float opacity) {
+void Hy3TabBarEntry::renderText(float scale, CBox& box, float opacity, Hy3TabBatch& batch) {
 	// clang-format off
 	static const auto render_text = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:render_text");
 	static const auto text_center = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:text_center");
@@ -246,14 +247,30 @@ void Hy3TabBarEntry::renderText(float scale, CBox& box, float opacity) {
 	// clang-format on
 
 	if (!*render_text) {
-		if (this->texture) this->texture.reset();
+		// a pending request means the atlas exists, don't create it otherwise
+		if (this->text_request != 0) Hy3GlyphAtlas::existing()->cancel(this->text_request);
+		this->text_request = 0;
+		this->text.reset();
 		return;
 	}
 
+	auto& atlas = Hy3GlyphAtlas::instance();
+
+	if (this->text_request != 0) {
+		if (auto text = atlas.take(this->text_request)) {
+			this->text = text;
+			this->text_request = 0;
+			this->last_render.full_logical_width = text->full_logical_width;
+		}
+	}
+
 	auto padding = *text_padding * scale;
 	auto width = box.width - padding * 2;
+	auto logical_width = this->text ? this->text->logical_width : 0;
 
-	if (!this->texture
+	// Shaping happens off the render thread, the previous text is drawn until it
+	// finishes, including after the atlas was emptied.
+	if ((this->text_request == 0 && (!this->text || !atlas.current(*this->text)))
 	    // clang-format off
 	    || this->last_render.window_title != this->window_title
 			|| this->last_render.text_font != *text_font
@@ -264,7 +281,7 @@ void Hy3TabBarEntry::renderText(float scale, CBox& box, float opacity) {
 	    // the text is probably ellipsized and needs to be recalculated.
 	    || (width != this->last_render.render_width
 	        && (width < this->last_render.full_logical_width
-	            || this->last_render.logical_width != this->last_render.full_logical_width)))
+	            || logical_width != this->last_render.full_logical_width)))
 	{
 		this->last_render.window_title = this->window_title;
 		this->last_render.text_font = *text_font;
@@ -272,102 +289,25 @@ void Hy3TabBarEntry::renderText(float scale, CBox& box, float opacity) {
 		this->last_render.scale = scale;
 		this->last_render.render_width = width;
 
-		auto* font_map = pango_cairo_font_map_get_default();
-		auto* context = pango_font_map_create_context(font_map);
-		auto* layout = pango_layout_new(context);
-		pango_layout_set_text(layout, this->window_title.c_str(), -1);
-
-		auto* font_desc = pango_font_description_from_string(*text_font);
-		pango_font_description_set_size(font_desc, *text_height * scale * PANGO_SCALE);
-		pango_layout_set_font_description(layout, font_desc);
-		pango_font_description_free(font_desc);
-
-		PangoRectangle ink_extents;
-		PangoRectangle logical_extents;
-
-		pango_layout_get_extents(layout, &ink_extents, &logical_extents);
-		this->last_render.full_logical_width = PANGO_PIXELS(logical_extents.width);
-
-		pango_layout_set_width(layout, width * PANGO_SCALE);
-		pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
-
-		pango_layout_get_extents(layout, &ink_extents, &logical_extents);
-
-		auto ink_x = PANGO_PIXELS(ink_extents.x);
-		auto ink_y = PANGO_PIXELS(ink_extents.y);
-		auto ink_width = PANGO_PIXELS(ink_extents.width);
-		auto ink_height = PANGO_PIXELS(ink_extents.height);
-
-		this->last_render.logical_width = PANGO_PIXELS(logical_extents.width);
-		this->last_render.logical_height = PANGO_PIXELS(logical_extents.height);
-
-		this->last_render.texture_x_offset = ink_x;
-		this->last_render.texture_y_offset = ink_y;
-		this->last_render.texture_width = ink_width;
-		this->last_render.texture_height = ink_height;
-
-		auto cairo_surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, ink_width, ink_height);
-		auto cairo = cairo_create(cairo_surface);
-
-		cairo_save(cairo);
-		cairo_set_operator(cairo, CAIRO_OPERATOR_CLEAR);
-		cairo_paint(cairo);
-		cairo_restore(cairo);
-
-		cairo_set_source_rgba(cairo, 1, 1, 1, 1);
-		cairo_move_to(cairo, -ink_x, -ink_y);
-
-		pango_cairo_update_layout(cairo, layout);
-		pango_cairo_show_layout(cairo, layout);
+		if (this->text_request != 0) atlas.cancel(this->text_request);
+		this->text_request = 0;
 
-		cairo_surface_flush(cairo_surface);
+		auto key = Hy3GlyphAtlas::key(this->window_title, *text_font, *text_height, scale, width);
 
-		g_object_unref(layout);
-		g_object_unref(context);
-
-		auto data = cairo_image_surface_get_data(cairo_surface);
-
-		if (!this->texture) this->texture = makeShared<CTexture>();
-		this->texture->allocate();
-
-		glBindTexture(GL_TEXTURE_2D, this->texture->m_texID);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
-
-#ifdef GLES32
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_R, GL_BLUE);
-		glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_SWIZZLE_B, GL_RED);
-#endif
-
-		glTexImage2D(
-		    GL_TEXTURE_2D,
-		    0,
-		    GL_RGBA,
-		    ink_width,
-		    ink_height,
-		    0,
-		    GL_RGBA,
-		    GL_UNSIGNED_BYTE,
-		    data
-		);
-
-		cairo_destroy(cairo);
-		cairo_surface_destroy(cairo_surface);
+		if (auto text = atlas.cached(key)) {
+			this->text = text;
+			this->last_render.full_logical_width = text->full_logical_width;
+		} else {
+			this->text_request = atlas.request(std::move(key));
+		}
 	}
 
-	auto x_offset =
-	    *text_center ? box.w * 0.5 - this->last_render.logical_width * 0.5 : *text_padding;
+	if (!this->text) return;
 
-	auto y_offset = box.h * 0.5 - this->last_render.logical_height * 0.5;
-
-	auto texture_box = CBox {
-	    box.x + x_offset + this->last_render.texture_x_offset,
-	    box.y + y_offset + this->last_render.texture_y_offset,
-	    this->last_render.texture_width,
-	    this->last_render.texture_height,
-	};
+	auto x_offset = *text_center ? box.w * 0.5 - this->text->logical_width * 0.5 : *text_padding;
+	auto y_offset = box.h * 0.5 - this->text->logical_height * 0.5;
 
-	texture_box.round();
+	auto origin = Vector2D(box.x + x_offset, box.y + y_offset).round();
 
 	auto c = mergeColors(
 	    *col_text_active,
@@ -378,13 +318,12 @@ void Hy3TabBarEntry::renderText(float scale, CBox& box, float opacity) {
 	    *col_text_inactive
 	);
 
-	glBlendFunc(GL_CONSTANT_COLOR, GL_ONE_MINUS_SRC_ALPHA);
-	glBlendColor(c.r, c.g, c.b, c.a);
-
-	g_pHyprOpenGL->renderTexture(this->texture, texture_box, { .a = opacity });
-
-	glBlendColor(1, 1, 1, 1);
-	glBlendFunc(GL_ONE, GL_ONE_MINUS_SRC_ALPHA);
+	batch.texts.push_back({
+	    .layout = this->text,
+	    .origin = origin,
+	    .color = c,
+	    .opacity = opacity,
+	});
 }
 
 CHyprColor Hy3TabBarEntry::mergeColors(
@@ -441,6 +380,7 @@ void Hy3TabBar::beginDestroy() {
 }
 
 void Hy3TabBar::tick() {
+	auto* atlas = Hy3GlyphAtlas::existing();
 	auto iter = this->entries.begin();
 
 	while (iter != this->entries.end()) {
@@ -451,6 +391,11 @@ void Hy3TabBar::tick() {
 				this->dirty = true;
 			}
 
+			// redraw once a title finishes shaping on the atlas worker
+			if (atlas != nullptr && iter->text_request != 0 && atlas->finished(iter->text_request)) {
+				this->dirty = true;
+			}
+
 			iter = std::next(iter);
 		}
 	}
@@ -458,7 +403,7 @@ void Hy3TabBar::tick() {
 	if (this->entries.empty()) this->destroy = true;
 }
 
-void Hy3TabBar::updateNodeList(std::list<UP<Hy3Node>>& nodes) {
+void Hy3TabBar::updateNodeList(std::vector<UP<Hy3Node>>& nodes) {
 	std::list<Hy3TabBarEntry> pool;
 	pool.splice(pool.begin(), this->entries);
 
@@ -632,6 +577,8 @@ void Hy3TabGroup::updateWithGroup(Hy3Node& node, bool warp) {
 	auto tsize = Vector2D(node.visualBox.w, *bar_height);
 
 	this->hidden = node.hidden;
+	if (auto* layout = node.layout()) this->single_window = layout->single_window;
+
 	if (this->pos->goal() != tpos) {
 		*this->pos = tpos;
 		if (warp) this->pos->warp();
@@ -673,12 +620,7 @@ void Hy3TabGroup::tick() {
 	if (valid(this->workspace)) {
 		auto has_fullscreen = this->workspace->m_hasFullscreenWindow;
 
-		if (!has_fullscreen && *no_gaps_when_only) {
-			auto* hy3 = hy3InstanceForWorkspace(this->workspace);
-			auto root_node = hy3 ? hy3->getWorkspaceRootGroup(this->workspace.get()) : nullptr;
-			has_fullscreen = root_node != nullptr && root_node->as_group().children.size() == 1
-			              && root_node->as_group().children.front()->is_target();
-		}
+		if (!has_fullscreen && *no_gaps_when_only) has_fullscreen = this->single_window;
 
 		if (has_fullscreen) {
 			if (this->bar.fade_opacity->goal() != 0.0) *this->bar.fade_opacity = 0.0;
@@ -756,6 +698,8 @@ std::pair<CBox, CBox> Hy3TabGroup::getRenderBB() const {
 
 void Hy3TabGroup::renderTabBar() {
 	static const auto window_rounding = ConfigValue<Hyprlang::INT>("decoration:rounding");
+	static const auto blur = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:blur");
+	static const auto render_cache = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:render_cache");
 	static const auto enter_from_top = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:from_top");
 	static const auto padding = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:padding");
 
@@ -839,6 +783,9 @@ void Hy3TabGroup::renderTabBar() {
 	auto fade_opacity = this->bar.fade_opacity->value()
 	                  * (valid(this->workspace) ? this->workspace->m_alpha->value() : 1.0);
 
+	static Hy3TabBatch batch;
+	batch.clear();
+
 	auto render_entry = [&](Hy3TabBarEntry& entry) {
 		Vector2D entry_pos = {
 		    (box.x + (entry.offset->value() * box.w) + (*padding * 0.5)) * scale,
@@ -857,7 +804,7 @@ void Hy3TabGroup::renderTabBar() {
 		};
 
 		box.round();
-		entry.render(scale, box, fade_opacity);
+		entry.render(scale, box, fade_opacity, batch);
 	};
 
 	for (auto& entry: this->bar.entries) {
@@ -870,6 +817,18 @@ void Hy3TabGroup::renderTabBar() {
 		render_entry(entry);
 	}
 
+	// sometimes enabled before our renderer is called
+	g_pHyprOpenGL->scissor(nullptr);
+
+	// blurred backgrounds depend on what is behind the bar, so caching them saves nothing
+	auto cache = *render_cache && !*blur && !render_stencil && this->settled();
+
+	if (!cache || !this->renderCached(scale, batch)) {
+		// all backgrounds, then all titles, so the bar costs two draws in the common case
+		Hy3Render::renderTabs(batch.tabs, *blur);
+		Hy3Render::renderTexts(batch.texts);
+	}
+
 	if (render_stencil) {
 		glClearStencil(0);
 		glStencilMask(0xff);
@@ -879,6 +838,130 @@ void Hy3TabGroup::renderTabBar() {
 	}
 }
 
+bool Hy3TabGroup::settled() const {
+	if (this->pos->isBeingAnimated() || this->size->isBeingAnimated()) return false;
+	if (this->bar.fade_opacity->isBeingAnimated() || this->bar.locked->isBeingAnimated()) return false;
+
+	if (valid(this->workspace)
+	    && (this->workspace->m_alpha->isBeingAnimated()
+	        || this->workspace->m_renderOffset->isBeingAnimated()))
+		return false;
+
+	for (auto& entry: this->bar.entries) {
+		for (auto* var: {
+		         &entry.active,
+		         &entry.focused,
+		         &entry.urgent,
+		         &entry.active_monitor,
+		         &entry.offset,
+		         &entry.width,
+		         &entry.vertical_pos,
+		         &entry.fade_opacity,
+		     })
+		{
+			if ((*var)->isBeingAnimated()) return false;
+		}
+	}
+
+	return true;
+}
+
+static bool sameColor(const CHyprColor& a, const CHyprColor& b) {
+	return a.r == b.r && a.g == b.g && a.b == b.b && a.a == b.a;
+}
+
+static bool sameBatch(const Hy3TabBatch& a, const Hy3TabBatch& b) {
+	if (a.tabs.size() != b.tabs.size() || a.texts.size() != b.texts.size()) return false;
+
+	for (size_t i = 0; i < a.tabs.size(); i++) {
+		auto& ta = a.tabs[i];
+		auto& tb = b.tabs[i];
+
+		if (ta.box != tb.box || !sameColor(ta.fill_color, tb.fill_color)
+		    || !sameColor(ta.border_color, tb.border_color) || ta.opacity != tb.opacity
+		    || ta.border_width != tb.border_width || ta.radius != tb.radius)
+			return false;
+	}
+
+	for (size_t i = 0; i < a.texts.size(); i++) {
+		auto& ta = a.texts[i];
+		auto& tb = b.texts[i];
+
+		if (ta.layout != tb.layout || ta.origin != tb.origin || !sameColor(ta.color, tb.color)
+		    || ta.opacity != tb.opacity)
+			return false;
+	}
+
+	return true;
+}
+
+bool Hy3TabGroup::renderCached(float scale, const Hy3TabBatch& batch) {
+	auto& rdata = g_pHyprOpenGL->m_renderData;
+	if (batch.tabs.empty() || !rdata.renderModif.modifs.empty()) return false;
+
+	auto x0 = batch.tabs.front().box.x;
+	auto y0 = batch.tabs.front().box.y;
+	auto x1 = x0;
+	auto y1 = y0;
+
+	for (auto& tab: batch.tabs) {
+		x0 = std::min(x0, tab.box.x);
+		y0 = std::min(y0, tab.box.y);
+		x1 = std::max(x1, tab.box.x + tab.box.w);
+		y1 = std::max(y1, tab.box.y + tab.box.h);
+	}
+
+	auto origin = Vector2D(std::floor(x0), std::floor(y0));
+	auto size = Vector2D(std::ceil(x1) - origin.x, std::ceil(y1) - origin.y);
+	if (size.x <= 0 || size.y <= 0) return false;
+
+	// The cache holds the bar relative to its top left, so moving the bar by whole
+	// pixels still hits.
+	static Hy3TabBatch local;
+	local.clear();
+
+	for (auto& tab: batch.tabs) {
+		local.tabs.push_back(tab);
+		local.tabs.back().box.translate(-origin);
+	}
+
+	for (auto& text: batch.texts) {
+		local.texts.push_back(text);
+		local.texts.back().origin = text.origin - origin;
+	}
+
+	auto& cache = this->bar_cache;
+
+	if (!cache.valid || cache.scale != scale || cache.size != size
+	    || !sameBatch(cache.batch, local))
+	{
+		if (cache.size != size || !cache.fb.isAllocated()) {
+			cache.fb.release();
+			cache.fb.alloc(size.x, size.y);
+		}
+
+		auto* target = rdata.currentFB;
+		cache.fb.bind();
+		glClearColor(0, 0, 0, 0);
+		glClear(GL_COLOR_BUFFER_BIT);
+
+		Hy3Render::beginOffscreen(size);
+		Hy3Render::renderTabs(local.tabs, false);
+		Hy3Render::renderTexts(local.texts);
+		Hy3Render::endOffscreen();
+
+		target->bind();
+
+		cache.batch = local;
+		cache.scale = scale;
+		cache.size = size;
+		cache.valid = true;
+	}
+
+	g_pHyprOpenGL->renderTexture(cache.fb.getTexture(), CBox {origin, size}, {.a = 1.0});
+	return true;
+}
+
 void Hy3TabPassElement::draw(const CRegion& damage) { this->group->renderTabBar(); }
 
 bool Hy3TabPassElement::needsPrecomputeBlur() {
@@ -9,6 +9,7 @@ class Hy3TabBar;
 #include <vector>
 
 #include <hyprland/src/plugins/PluginAPI.hpp>
+#include <hyprland/src/render/Framebuffer.hpp>
 #include <hyprland/src/render/Renderer.hpp>
 #include <hyprland/src/render/Texture.hpp>
 
@@ -30,11 +31,14 @@ struct Hy3TabGroupWrapper {
 };
 
 #include "Hy3Node.hpp"
+#include "TextAtlas.hpp"
+#include "render.hpp"
 
 struct Hy3TabBarEntry {
 	std::string window_title;
 	bool destroying = false;
-	SP<CTexture> texture;
+	SP<Hy3TextLayout> text;    // shared with the atlas layout cache
+	uint64_t text_request = 0; // pending atlas request, `text` is drawn until it finishes
 	PHLANIMVAR<float> active;
 	PHLANIMVAR<float> focused;
 	PHLANIMVAR<float> urgent;
@@ -56,16 +60,10 @@ struct Hy3TabBarEntry {
 		std::string text_font;
 		int font_height = 0;
 
-		int texture_x_offset = 0;
-		int texture_y_offset = 0;
-		int texture_width = 0;
-		int texture_height = 0;
-
-		int logical_width = 0;
-		int logical_height = 0;
 	} last_render;
 
 	Hy3TabBarEntry(Hy3TabBar&, Hy3Node&);
+	~Hy3TabBarEntry();
 	bool operator==(const Hy3Node&) const;
 	bool operator==(const Hy3TabBarEntry&) const;
 
@@ -77,10 +75,11 @@ struct Hy3TabBarEntry {
 	void beginDestroy();
 	void unDestroy();
 	bool shouldRemove();
-	void render(float scale, CBox& box, float opacity_mul);
+	// Add this entry's background and title to `batch`.
+	void render(float scale, CBox& box, float opacity_mul, Hy3TabBatch& batch);
 
 private:
-	void renderText(float scale, CBox& box, float opacity);
+	void renderText(float scale, CBox& box, float opacity, Hy3TabBatch& batch);
 	CHyprColor mergeColors(
 	    const CHyprColor& active,
 	    const CHyprColor& focused,
@@ -106,7 +105,7 @@ public:
 	void damageBox(const Vector2D* position, const Vector2D* size);
 
 	void tick();
-	void updateNodeList(std::list<UP<Hy3Node>>& nodes);
+	void updateNodeList(std::vector<UP<Hy3Node>>& nodes);
 	void updateAnimations(bool warp = false);
 	void setSize(Vector2D);
 
@@ -139,6 +138,8 @@ public:
 	PHLWINDOW target_window = nullptr;
 	PHLWORKSPACE workspace = nullptr;
 	bool hidden = false;
+	// Set by Hy3Layout while the workspace holds a single window outside any group.
+	bool single_window = false;
 	Hy3TabBar bar;
 	PHLANIMVAR<Vector2D> pos;
 	PHLANIMVAR<Vector2D> size;
@@ -168,6 +169,19 @@ private:
 	// moving a Hy3TabGroup will unregister any active animations
 	Hy3TabGroup(Hy3TabGroup&&) = delete;
 
+	// Last settled render of the bar, re-composited while nothing in it changes.
+	struct {
+		CFramebuffer fb;
+		Vector2D size;
+		float scale = 0.0;
+		Hy3TabBatch batch; // relative to the top left of the framebuffer
+		bool valid = false;
+	} bar_cache;
+
 	// UB if node is not a group.
 	void updateStencilWindows(Hy3Node&);
+	// True if nothing about the bar is animating.
+	bool settled() const;
+	// Draw the batch through bar_cache. False if it cannot be cached.
+	bool renderCached(float scale, const Hy3TabBatch& batch);
 };
@@ -0,0 +1,584 @@
+#include "TextAtlas.hpp"
+#include <algorithm>
+#include <format>
+
+#include <GLES2/gl2.h>
+#include <cairo/cairo.h>
+#include <hyprland/src/render/OpenGL.hpp>
+#include <pango/pangocairo.h>
+
+#include "globals.hpp"
+#include "log.hpp"
+
+static Hy3GlyphAtlas* INSTANCE = nullptr;
+
+Hy3GlyphAtlas& Hy3GlyphAtlas::instance() {
+	if (INSTANCE == nullptr) INSTANCE = new Hy3GlyphAtlas();
+	return *INSTANCE;
+}
+
+Hy3GlyphAtlas* Hy3GlyphAtlas::existing() { return INSTANCE; }
+
+void Hy3GlyphAtlas::destroy() {
+	delete INSTANCE;
+	INSTANCE = nullptr;
+}
+
+Hy3GlyphAtlas::Hy3GlyphAtlas() { this->worker = std::thread([this]() { this->run(); }); }
+
+Hy3GlyphAtlas::~Hy3GlyphAtlas() {
+	{
+		auto lock = std::lock_guard(this->mutex);
+		this->stopping = true;
+	}
+
+	this->wake.notify_one();
+	this->worker.join();
+
+	this->reset();
+
+	for (auto& [_, face]: this->faces) {
+		g_object_unref(face.layout);
+		g_object_unref(face.context);
+	}
+}
+
+Hy3TextKey Hy3GlyphAtlas::key(
+    std::string text,
+    std::string font,
+    int height,
+    float scale,
+    double max_width
+) {
+	auto width = std::max(static_cast<int>(max_width), 0);
+
+	return Hy3TextKey {
+	    .text = std::move(text),
+	    .font = std::move(font),
+	    .height = height,
+	    .scale = scale,
+	    .max_width = width - width % WIDTH_BUCKET,
+	};
+}
+
+SP<Hy3TextLayout> Hy3GlyphAtlas::cached(const Hy3TextKey& key) {
+	auto it = this->cache.find(key);
+
+	if (it == this->cache.end() || !this->current(*it->second.layout)) {
+		this->misses++;
+		return nullptr;
+	}
+
+	this->hits++;
+	this->lru.splice(this->lru.begin(), this->lru, it->second.lru);
+	return it->second.layout;
+}
+
+uint64_t Hy3GlyphAtlas::request(Hy3TextKey key) {
+	// clang-format off
+	static const auto cache_size = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:text_cache_size");
+	static const auto cache_layouts = ConfigValue<Hyprlang::INT>("plugin:hy3:tabs:text_cache_layouts");
+	// clang-format on
+
+	// one page per MiB of budget
+	this->max_pages = std::max(static_cast<size_t>(*cache_size) * 1024 * 1024 / PAGE_BYTES, size_t(1));
+	this->max_layouts = std::max(*cache_layouts, Hyprlang::INT(0));
+
+	uint64_t id;
+
+	{
+		auto lock = std::lock_guard(this->mutex);
+		id = this->next_id++;
+
+		this->results.emplace(id, std::nullopt);
+		this->jobs.push_back({.id = id, .key = key});
+	}
+
+	this->requests.emplace(id, std::move(key));
+	this->wake.notify_one();
+	return id;
+}
+
+bool Hy3GlyphAtlas::finished(uint64_t id) {
+	auto lock = std::lock_guard(this->mutex);
+	auto it = this->results.find(id);
+	return it != this->results.end() && it->second.has_value();
+}
+
+SP<Hy3TextLayout> Hy3GlyphAtlas::take(uint64_t id) {
+	std::optional<Hy3TextLayout> result;
+
+	{
+		auto lock = std::lock_guard(this->mutex);
+
+		auto it = this->results.find(id);
+		if (it == this->results.end() || !it->second) return nullptr;
+
+		result = std::move(it->second);
+		this->results.erase(it);
+	}
+
+	auto layout = makeShared<Hy3TextLayout>(std::move(*result));
+
+	auto request = this->requests.find(id);
+	if (request == this->requests.end()) return layout;
+
+	auto key = std::move(request->second);
+	this->requests.erase(request);
+
+	auto it = this->cache.find(key);
+	if (it != this->cache.end()) {
+		it->second.layout = layout;
+		this->lru.splice(this->lru.begin(), this->lru, it->second.lru);
+	} else {
+		this->lru.push_front(key);
+		this->cache.emplace(std::move(key), CacheEntry {.layout = layout, .lru = this->lru.begin()});
+		this->trimCache();
+	}
+
+	return layout;
+}
+
+void Hy3GlyphAtlas::cancel(uint64_t id) {
+	this->requests.erase(id);
+
+	auto lock = std::lock_guard(this->mutex);
+	this->results.erase(id);
+}
+
+// Drop the least recently used layouts no tab is drawing until the cache is back
+// under its limit. Layouts from before the atlas was last emptied go first.
+void Hy3GlyphAtlas::trimCache() {
+	for (auto it = this->cache.begin(); it != this->cache.end();) {
+		if (!this->current(*it->second.layout) && it->second.layout.strongRef() == 1) {
+			this->lru.erase(it->second.lru);
+			it = this->cache.erase(it);
+			this->evictions++;
+		} else {
+			it++;
+		}
+	}
+
+	auto it = this->lru.end();
+	while (this->cache.size() > this->max_layouts && it != this->lru.begin()) {
+		it--;
+
+		auto entry = this->cache.find(*it);
+		if (entry->second.layout.strongRef() != 1) continue;
+
+		this->cache.erase(entry);
+		it = this->lru.erase(it);
+		this->evictions++;
+	}
+
+	// every title drawn from the previous pages has been shaped again
+	auto previous_used = std::ranges::any_of(this->cache, [&](auto& entry) {
+		return entry.second.layout->generation == this->previous_pages.generation;
+	});
+
+	if (!previous_used) this->previous_pages = PageSet {};
+}
+
+const Hy3GlyphAtlas::PageSet* Hy3GlyphAtlas::pageSet(uint64_t generation) const {
+	if (generation == this->current_pages.generation) return &this->current_pages;
+	if (generation == this->previous_pages.generation && !this->previous_pages.textures.empty())
+		return &this->previous_pages;
+
+	return nullptr;
+}
+
+Hy3GlyphAtlas::PageSet* Hy3GlyphAtlas::uploadPageSet(uint64_t generation) {
+	if (generation == this->current_pages.generation) return &this->current_pages;
+	if (generation < this->current_pages.generation) {
+		return generation == this->previous_pages.generation ? &this->previous_pages : nullptr;
+	}
+
+	// The atlas was emptied. Keep the current pages for titles still drawn from them
+	// and fill the oldest textures, which nothing can draw from any more.
+	std::swap(this->current_pages, this->previous_pages);
+	this->current_pages.generation = generation;
+	return &this->current_pages;
+}
+
+Hy3GlyphAtlas::Stats Hy3GlyphAtlas::stats() const {
+	return Stats {
+	    .hits = this->hits,
+	    .misses = this->misses,
+	    .evictions = this->evictions,
+	    .cached = this->cache.size(),
+	    .budget_layouts = this->max_layouts,
+	    .pages = this->current_pages.textures.size() + this->previous_pages.textures.size(),
+	    .budget_pages = this->max_pages,
+	    .resets = this->generation - 1,
+	};
+}
+
+void Hy3GlyphAtlas::run() {
+	while (true) {
+		Job job;
+
+		{
+			auto lock = std::unique_lock(this->mutex);
+			this->wake.wait(lock, [this]() { return this->stopping || !this->jobs.empty(); });
+			if (this->stopping) return;
+
+			job = std::move(this->jobs.front());
+			this->jobs.pop_front();
+
+			// cancelled before it was picked up
+			if (!this->results.contains(job.id)) continue;
+		}
+
+		auto layout = this->layout(job.key);
+
+		// Publish the glyphs together with the layout, so a layout that has been
+		// taken never references glyphs the render thread cannot upload yet.
+		auto lock = std::lock_guard(this->mutex);
+
+		for (auto& upload: this->rasterized) {
+			this->uploads.push_back(std::move(upload));
+		}
+
+		this->rasterized.clear();
+
+		auto it = this->results.find(job.id);
+		if (it != this->results.end()) it->second = std::move(layout);
+	}
+}
+
+Hy3GlyphAtlas::Face& Hy3GlyphAtlas::face(const std::string& font, int height, float scale) {
+	auto key = std::format("{}:{}:{}", font, height, scale);
+
+	auto it = this->faces.find(key);
+	if (it != this->faces.end()) return it->second;
+
+	auto* font_map = pango_cairo_font_map_get_default();
+	auto* context = pango_font_map_create_context(font_map);
+
+	// glyphs are rasterized to ARGB so color glyphs survive, where outline glyphs
+	// would otherwise be subpixel antialiased
+	auto* options = cairo_font_options_create();
+	cairo_font_options_set_antialias(options, CAIRO_ANTIALIAS_GRAY);
+	pango_cairo_context_set_font_options(context, options);
+	cairo_font_options_destroy(options);
+
+	auto* layout = pango_layout_new(context);
+
+	auto* font_desc = pango_font_description_from_string(font.c_str());
+	pango_font_description_set_size(font_desc, height * scale * PANGO_SCALE);
+	pango_layout_set_font_description(layout, font_desc);
+	pango_font_description_free(font_desc);
+
+	pango_layout_set_ellipsize(layout, PANGO_ELLIPSIZE_END);
+
+	return this->faces.emplace(key, Face {.context = context, .layout = layout}).first->second;
+}
+
+Hy3TextLayout Hy3GlyphAtlas::layout(const Hy3TextKey& key) {
+	auto* layout = this->face(key.font, key.height, key.scale).layout;
+	pango_layout_set_text(layout, key.text.c_str(), -1);
+
+	PangoRectangle logical_extents;
+
+	pango_layout_set_width(layout, -1);
+	pango_layout_get_extents(layout, nullptr, &logical_extents);
+
+	auto result = Hy3TextLayout {.full_logical_width = PANGO_PIXELS(logical_extents.width)};
+
+	pango_layout_set_width(layout, key.max_width * PANGO_SCALE);
+	pango_layout_get_extents(layout, nullptr, &logical_extents);
+
+	result.logical_width = PANGO_PIXELS(logical_extents.width);
+	result.logical_height = PANGO_PIXELS(logical_extents.height);
+
+	// placing a glyph can empty a full atlas, invalidating glyphs placed before it
+	for (auto attempt = 0; attempt < 2; attempt++) {
+		result.glyphs.clear();
+		result.generation = this->generation;
+
+		auto* iter = pango_layout_get_iter(layout);
+
+		do {
+			auto* run = pango_layout_iter_get_run_readonly(iter);
+			if (run == nullptr) continue;
+
+			PangoRectangle run_extents;
+			pango_layout_iter_get_run_extents(iter, nullptr, &run_extents);
+			auto baseline = pango_layout_iter_get_baseline(iter);
+			auto pen = run_extents.x;
+
+			for (auto i = 0; i < run->glyphs->num_glyphs; i++) {
+				auto& info = run->glyphs->glyphs[i];
+
+				if (info.glyph != PANGO_GLYPH_EMPTY) {
+					auto* slot = this->glyph(run->item->analysis.font, info.glyph);
+
+					if (slot != nullptr && slot->w != 0) {
+						auto x = PANGO_PIXELS(pen + info.geometry.x_offset) + slot->bearing_x;
+						auto y = PANGO_PIXELS(baseline + info.geometry.y_offset) + slot->bearing_y;
+
+						result.glyphs.push_back({
+						    .page = slot->page,
+						    .x = static_cast<float>(x),
+						    .y = static_cast<float>(y),
+						    .w = static_cast<float>(slot->w),
+						    .h = static_cast<float>(slot->h),
+						    .u0 = static_cast<float>(slot->x) / PAGE_SIZE,
+						    .v0 = static_cast<float>(slot->y) / PAGE_SIZE,
+						    .u1 = static_cast<float>(slot->x + slot->w) / PAGE_SIZE,
+						    .v1 = static_cast<float>(slot->y + slot->h) / PAGE_SIZE,
+						    .color = slot->color,
+						});
+					}
+				}
+
+				pen += info.geometry.width;
+			}
+		} while (pango_layout_iter_next_run(iter));
+
+		pango_layout_iter_free(iter);
+
+		if (result.generation == this->generation) break;
+	}
+
+	return result;
+}
+
+const Hy3GlyphAtlas::Slot* Hy3GlyphAtlas::glyph(PangoFont* font, PangoGlyph glyph) {
+	auto key = GlyphKey {.font = font, .glyph = glyph};
+
+	auto it = this->glyphs.find(key);
+	if (it != this->glyphs.end()) return &it->second;
+
+	PangoRectangle ink;
+	pango_font_get_glyph_extents(font, glyph, &ink, nullptr);
+
+	// one pixel of padding so sampling never bleeds into neighbours
+	auto x0 = PANGO_PIXELS_FLOOR(ink.x) - 1;
+	auto y0 = PANGO_PIXELS_FLOOR(ink.y) - 1;
+	auto w = ink.width == 0 ? 0 : PANGO_PIXELS_CEIL(ink.x + ink.width) + 1 - x0;
+	auto h = ink.height == 0 ? 0 : PANGO_PIXELS_CEIL(ink.y + ink.height) + 1 - y0;
+
+	auto slot = Slot {
+	    .page = 0,
+	    .x = 0,
+	    .y = 0,
+	    .w = 0,
+	    .h = 0,
+	    .bearing_x = x0,
+	    .bearing_y = y0,
+	    .color = false,
+	};
+
+	// blank glyphs such as spaces only advance the pen
+	if (w > 0 && h > 0) {
+		auto* surface = cairo_image_surface_create(CAIRO_FORMAT_ARGB32, w, h);
+		auto* cairo = cairo_create(surface);
+
+		auto* string = pango_glyph_string_new();
+		pango_glyph_string_set_size(string, 1);
+		string->glyphs[0].glyph = glyph;
+		string->glyphs[0].geometry = {.width = 0, .x_offset = 0, .y_offset = 0};
+		string->glyphs[0].attr.is_cluster_start = 1;
+		string->log_clusters[0] = 0;
+
+		cairo_set_source_rgba(cairo, 1, 1, 1, 1);
+		cairo_move_to(cairo, -x0, -y0);
+		pango_cairo_show_glyph_string(cairo, font, string);
+		cairo_surface_flush(surface);
+
+		pango_glyph_string_free(string);
+		cairo_destroy(cairo);
+
+		auto* data = cairo_image_surface_get_data(surface);
+		auto stride = cairo_image_surface_get_stride(surface);
+		auto pixel = [&](int col, int row) {
+			return reinterpret_cast<const uint32_t*>(data + row * stride)[col];
+		};
+
+		// Drawn in premultiplied white, every channel of an outline glyph matches its
+		// alpha. Anything else came from a color font.
+		for (auto row = 0; row < h && !slot.color; row++) {
+			for (auto col = 0; col < w; col++) {
+				auto argb = pixel(col, row);
+				auto a = argb >> 24;
+
+				if ((argb & 0xff) != a || ((argb >> 8) & 0xff) != a || ((argb >> 16) & 0xff) != a) {
+					slot.color = true;
+					break;
+				}
+			}
+		}
+
+		if (!this->pack(w, h, slot.color, slot.page, slot.x, slot.y)) {
+			hy3_log(ERR, "glyph {} ({}x{}) does not fit in the glyph atlas", glyph, w, h);
+			cairo_surface_destroy(surface);
+			return nullptr;
+		}
+
+		slot.w = w;
+		slot.h = h;
+
+		auto upload = Upload {
+		    .generation = this->generation,
+		    .page = slot.page,
+		    .x = slot.x,
+		    .y = slot.y,
+		    .w = w,
+		    .h = h,
+		    .color = slot.color,
+		};
+
+		upload.pixels.reserve(w * h * (slot.color ? 4 : 1));
+
+		for (auto row = 0; row < h; row++) {
+			for (auto col = 0; col < w; col++) {
+				auto argb = pixel(col, row);
+
+				if (slot.color) {
+					upload.pixels.insert(
+					    upload.pixels.end(),
+					    {
+					        static_cast<uint8_t>(argb >> 16),
+					        static_cast<uint8_t>(argb >> 8),
+					        static_cast<uint8_t>(argb),
+					        static_cast<uint8_t>(argb >> 24),
+					    }
+					);
+				} else {
+					upload.pixels.push_back(argb >> 24);
+				}
+			}
+		}
+
+		this->rasterized.push_back(std::move(upload));
+		cairo_surface_destroy(surface);
+	}
+
+	g_object_ref(font);
+	return &this->glyphs.emplace(key, slot).first->second;
+}
+
+bool Hy3GlyphAtlas::pack(int w, int h, bool color, size_t& page, int& x, int& y) {
+	if (w > PAGE_SIZE || h > PAGE_SIZE) return false;
+
+	for (auto attempt = 0; attempt < 2; attempt++) {
+		// glyphs are packed into the last page of their format
+		auto it = std::find_if(this->pages.rbegin(), this->pages.rend(), [&](auto& shelf) {
+			return shelf.color == color;
+		});
+
+		if (it != this->pages.rend()) {
+			auto& shelf = *it;
+
+			// start a new shelf below the current one, or a new page below that
+			if (shelf.cursor + w > PAGE_SIZE) {
+				shelf.y += shelf.height;
+				shelf.height = 0;
+				shelf.cursor = 0;
+			}
+
+			if (shelf.y + h <= PAGE_SIZE) {
+				page = this->pages.rend() - it - 1;
+				x = shelf.cursor;
+				y = shelf.y;
+
+				shelf.cursor += w;
+				shelf.height = std::max(shelf.height, h);
+				return true;
+			}
+		}
+
+		size_t used = 0;
+		for (auto& shelf: this->pages) {
+			used += shelf.color ? COLOR_PAGE_COST : 1;
+		}
+
+		if (!this->pages.empty() && used + (color ? COLOR_PAGE_COST : 1) > this->max_pages) {
+			hy3_log(LOG, "glyph atlas is full, emptying it");
+			this->reset();
+		}
+
+		this->pages.push_back(Shelf {.color = color});
+	}
+
+	return false;
+}
+
+void Hy3GlyphAtlas::reset() {
+	for (auto& [key, _]: this->glyphs) {
+		g_object_unref(key.font);
+	}
+
+	this->glyphs.clear();
+	this->pages.clear();
+	this->generation++;
+}
+
+void Hy3GlyphAtlas::flushUploads() {
+	std::vector<Upload> uploads;
+
+	{
+		auto lock = std::lock_guard(this->mutex);
+		uploads.swap(this->uploads);
+	}
+
+	if (uploads.empty()) return;
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 1);
+
+	for (auto& upload: uploads) {
+		auto* pages = this->uploadPageSet(upload.generation);
+		if (pages == nullptr) continue;
+
+		while (pages->textures.size() <= upload.page) {
+			auto texture = makeShared<CTexture>();
+			texture->allocate();
+
+			glBindTexture(GL_TEXTURE_2D, texture->m_texID);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+			glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+
+			// storage is allocated below, once the page's format is known
+			pages->textures.push_back(texture);
+			pages->color.push_back(!upload.color);
+		}
+
+		auto format = upload.color ? GL_RGBA : GL_ALPHA;
+		glBindTexture(GL_TEXTURE_2D, pages->textures[upload.page]->m_texID);
+
+		// pages are reused with another format once the atlas has been emptied
+		if (pages->color[upload.page] != upload.color) {
+			glTexImage2D(
+			    GL_TEXTURE_2D,
+			    0,
+			    format,
+			    PAGE_SIZE,
+			    PAGE_SIZE,
+			    0,
+			    format,
+			    GL_UNSIGNED_BYTE,
+			    nullptr
+			);
+
+			pages->color[upload.page] = upload.color;
+		}
+
+		glTexSubImage2D(
+		    GL_TEXTURE_2D,
+		    0,
+		    upload.x,
+		    upload.y,
+		    upload.w,
+		    upload.h,
+		    format,
+		    GL_UNSIGNED_BYTE,
+		    upload.pixels.data()
+		);
+	}
+
+	glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
@@ -0,0 +1,234 @@
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <list>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+#include <unordered_map>
+#include <vector>
+
+#include <hyprland/src/render/Texture.hpp>
+#include <pango/pango.h>
+
+// A glyph in the atlas, placed relative to the top left of its layout's logical extents.
+struct Hy3GlyphQuad {
+	size_t page;
+	float x, y, w, h;
+	float u0, v0, u1, v1;
+	bool color; // drawn with its own colors, such as emoji
+};
+
+// Shaped text, drawn from the glyph atlas.
+struct Hy3TextLayout {
+	std::vector<Hy3GlyphQuad> glyphs;
+	int logical_width = 0;
+	int logical_height = 0;
+	int full_logical_width = 0; // before ellipsizing
+	uint64_t generation = 0;    // atlas generation the glyphs were placed in
+};
+
+// Everything a shaped layout depends on. Create with Hy3GlyphAtlas::key.
+struct Hy3TextKey {
+	std::string text;
+	std::string font;
+	int height;
+	float scale;
+	int max_width; // rounded down to Hy3GlyphAtlas::WIDTH_BUCKET
+
+	bool operator==(const Hy3TextKey&) const = default;
+};
+
+// Glyphs of every font, size and scale used by tab titles, packed into shared
+// textures. Titles are shaped once and drawn as a quad per glyph, so changing a
+// title only rasterizes glyphs that have not been seen before.
+//
+// Most glyphs only need coverage and are kept on alpha pages. Glyphs from color
+// fonts are kept on separate RGBA pages.
+//
+// Shaping and rasterization run on a worker thread which owns all pango state.
+// Finished glyphs are uploaded on the render thread by flushUploads().
+//
+// Shaped layouts are cached across tab bars, so titles that reappear after a
+// group is retabbed or a window changes groups are not shaped again.
+class Hy3GlyphAtlas {
+public:
+	static constexpr int PAGE_SIZE = 1024;
+	static constexpr size_t PAGE_BYTES = PAGE_SIZE * PAGE_SIZE; // one byte of alpha per texel
+	// Budget taken by an RGBA page, in alpha pages.
+	static constexpr size_t COLOR_PAGE_COST = 4;
+	// Widths are bucketed so resizing a bar rarely needs a new layout.
+	static constexpr int WIDTH_BUCKET = 8;
+
+	struct Stats {
+		size_t hits;
+		size_t misses;
+		size_t evictions;
+		size_t cached;
+		size_t budget_layouts;
+		size_t pages;
+		size_t budget_pages;
+		uint64_t resets;
+	};
+
+	static Hy3GlyphAtlas& instance();
+	// The atlas if it exists, without creating it.
+	static Hy3GlyphAtlas* existing();
+	static void destroy();
+
+	static Hy3TextKey
+	key(std::string text, std::string font, int height, float scale, double max_width);
+
+	// The cached layout for `key`, if it is still current. Counts a hit or miss.
+	SP<Hy3TextLayout> cached(const Hy3TextKey& key);
+
+	// Queue `key` to be shaped. Returns a request id for finished(), take() and cancel().
+	uint64_t request(Hy3TextKey key);
+	bool finished(uint64_t id);
+	// Take the layout of a finished request and add it to the cache.
+	SP<Hy3TextLayout> take(uint64_t id);
+	void cancel(uint64_t id);
+
+	// False if the atlas was emptied since the layout was shaped.
+	bool current(const Hy3TextLayout& layout) const { return layout.generation == this->generation; }
+
+	// True if the glyphs of `layout` are still uploaded. Layouts from before the atlas
+	// was last emptied stay drawable until they are shaped again. Render thread only.
+	bool drawable(const Hy3TextLayout& layout) const {
+		return this->pageSet(layout.generation) != nullptr;
+	}
+
+	// Upload glyphs rasterized since the last call. Render thread only.
+	void flushUploads();
+	// Texture of a page of the given generation. Only valid for drawable layouts.
+	const SP<CTexture>& page(uint64_t generation, size_t index) const {
+		return this->pageSet(generation)->textures[index];
+	}
+
+	Stats stats() const;
+
+	~Hy3GlyphAtlas();
+
+private:
+	struct Face {
+		PangoContext* context;
+		PangoLayout* layout;
+	};
+
+	struct GlyphKey {
+		PangoFont* font;
+		PangoGlyph glyph;
+
+		bool operator==(const GlyphKey&) const = default;
+	};
+
+	struct GlyphKeyHash {
+		size_t operator()(const GlyphKey& key) const {
+			return std::hash<void*>()(key.font) ^ (std::hash<uint32_t>()(key.glyph) << 1);
+		}
+	};
+
+	struct TextKeyHash {
+		size_t operator()(const Hy3TextKey& key) const {
+			auto hash = std::hash<std::string>()(key.text);
+			hash = hash * 31 + std::hash<std::string>()(key.font);
+			hash = hash * 31 + std::hash<int>()(key.height);
+			hash = hash * 31 + std::hash<float>()(key.scale);
+			return hash * 31 + std::hash<int>()(key.max_width);
+		}
+	};
+
+	struct Slot {
+		size_t page;
+		int x, y, w, h;
+		int bearing_x, bearing_y; // offset of the bitmap from the pen position
+		bool color;
+	};
+
+	struct Shelf {
+		bool color = false; // format of the page
+		int y = 0;
+		int height = 0;
+		int cursor = 0;
+	};
+
+	struct Upload {
+		uint64_t generation;
+		size_t page;
+		int x, y, w, h;
+		bool color; // premultiplied RGBA rather than alpha
+		std::vector<uint8_t> pixels;
+	};
+
+	struct Job {
+		uint64_t id;
+		Hy3TextKey key;
+	};
+
+	struct CacheEntry {
+		SP<Hy3TextLayout> layout;
+		std::list<Hy3TextKey>::iterator lru;
+	};
+
+	// worker thread only
+	std::unordered_map<std::string, Face> faces;
+	std::unordered_map<GlyphKey, Slot, GlyphKeyHash> glyphs;
+	std::vector<Shelf> pages; // packing state of each page
+	std::vector<Upload> rasterized; // not yet handed to the render thread
+
+	// guarded by `mutex`
+	std::mutex mutex;
+	std::condition_variable wake;
+	bool stopping = false;
+	uint64_t next_id = 1;
+	std::deque<Job> jobs;
+	// requests that have not been cancelled or taken, and their layout once shaped
+	std::unordered_map<uint64_t, std::optional<Hy3TextLayout>> results;
+	std::vector<Upload> uploads;
+
+	// Textures holding the pages of one atlas generation.
+	struct PageSet {
+		uint64_t generation = 0;
+		std::vector<SP<CTexture>> textures;
+		std::vector<bool> color; // format each texture was allocated with
+	};
+
+	// render thread only
+	// The generation being filled, and the one before it. The previous pages are
+	// kept while titles shaped into them are drawn, until they are shaped again.
+	PageSet current_pages;
+	PageSet previous_pages;
+	std::unordered_map<uint64_t, Hy3TextKey> requests;
+	std::unordered_map<Hy3TextKey, CacheEntry, TextKeyHash> cache;
+	std::list<Hy3TextKey> lru; // most recently used first
+	size_t hits = 0;
+	size_t misses = 0;
+	size_t evictions = 0;
+	// Layouts kept before the least recently used unused ones are dropped.
+	// Set from plugin:hy3:tabs:text_cache_layouts.
+	size_t max_layouts = 256;
+
+	std::atomic<uint64_t> generation = 1;
+	// Pages filled before the atlas is emptied and refilled with glyphs in use.
+	// Set from plugin:hy3:tabs:text_cache_size.
+	std::atomic<size_t> max_pages = 8;
+	std::thread worker;
+
+	Hy3GlyphAtlas();
+
+	void run();
+	Hy3TextLayout layout(const Hy3TextKey& key);
+	Face& face(const std::string& font, int height, float scale);
+	const Slot* glyph(PangoFont* font, PangoGlyph glyph);
+	bool pack(int w, int h, bool color, size_t& page, int& x, int& y);
+	void reset();
+	void trimCache();
+	const PageSet* pageSet(uint64_t generation) const;
+	// The pages uploads of `generation` go to, moving on to new pages once the atlas
+	// has been emptied. Null for generations older than the previous one.
+	PageSet* uploadPageSet(uint64_t generation);
+};
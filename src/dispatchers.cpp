@@ -1,3 +1,6 @@
+#include <algorithm>
+#include <chrono>
+#include <format>
 #include <optional>
 
 #include <hyprland/src/Compositor.hpp>
@@ -18,6 +21,7 @@ static Hy3Layout* hy3InstanceForAction(bool allow_fullscreen = false) {
 static SDispatchResult dispatch_makegroup(std::string value) {
 	auto* hy3 = hy3InstanceForAction();
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 	auto ws = hy3->workspace();
 
 	auto args = CVarList(value);
@@ -47,6 +51,7 @@ static SDispatchResult dispatch_makegroup(std::string value) {
 static SDispatchResult dispatch_changegroup(std::string value) {
 	auto* hy3 = hy3InstanceForAction();
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 	auto ws = hy3->workspace();
 
 	auto args = CVarList(value);
@@ -70,6 +75,7 @@ static SDispatchResult dispatch_changegroup(std::string value) {
 static SDispatchResult dispatch_setephemeral(std::string value) {
 	auto* hy3 = hy3InstanceForAction();
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 
 	auto args = CVarList(value);
 
@@ -90,6 +96,7 @@ std::optional<ShiftDirection> parseShiftArg(std::string arg) {
 static SDispatchResult dispatch_movewindow(std::string value) {
 	auto* hy3 = hy3InstanceForAction();
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 
 	auto args = CVarList(value);
 
@@ -108,7 +115,13 @@ static SDispatchResult dispatch_movewindow(std::string value) {
 			i++;
 		}
 
-		hy3->shiftWindow(hy3->workspace().get(), shift.value(), once, visible);
+		auto geometric = args[i] == "geometric";
+
+		// geometric moves don't walk the tree, so there are no subgroups to skip
+		if (geometric && once)
+			return {.success = false, .error = "geometric cannot be combined with once"};
+
+		hy3->shiftWindow(hy3->workspace().get(), shift.value(), once, visible, geometric);
 	}
 	return SDispatchResult {};
 }
@@ -116,6 +129,7 @@ static SDispatchResult dispatch_movewindow(std::string value) {
 static SDispatchResult dispatch_movefocus(std::string value) {
 	auto* hy3 = hy3InstanceForAction(true);
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 	auto ws = hy3->workspace();
 
 	auto args = CVarList(value);
@@ -134,16 +148,24 @@ static SDispatchResult dispatch_movefocus(std::string value) {
 	auto visible = args[argi] == "visible";
 	if (visible) argi++;
 
-	if (args[argi] == "nowarp") warp_cursor = false;
-	else if (args[argi] == "warp") warp_cursor = true;
+	if (args[argi] == "nowarp") {
+		warp_cursor = false;
+		argi++;
+	} else if (args[argi] == "warp") {
+		warp_cursor = true;
+		argi++;
+	}
+
+	auto geometric = args[argi] == "geometric";
 
-	hy3->shiftFocus(ws.get(), shift.value(), visible, warp_cursor);
+	hy3->shiftFocus(ws.get(), shift.value(), visible, warp_cursor, geometric);
 	return SDispatchResult {};
 }
 
 static SDispatchResult dispatch_togglefocuslayer(std::string value) {
 	auto* hy3 = hy3InstanceForAction();
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 
 	hy3->toggleFocusLayer(hy3->workspace().get(), value != "nowarp");
 	return SDispatchResult {};
@@ -152,6 +174,7 @@ static SDispatchResult dispatch_togglefocuslayer(std::string value) {
 static SDispatchResult dispatch_warpcursor(std::string value) {
 	auto* hy3 = hy3InstanceForAction(true);
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 
 	hy3->warpCursor();
 	return SDispatchResult {};
@@ -160,6 +183,7 @@ static SDispatchResult dispatch_warpcursor(std::string value) {
 static SDispatchResult dispatch_move_to_workspace(std::string value) {
 	auto* hy3 = hy3InstanceForAction(true);
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 
 	auto args = CVarList(value);
 
@@ -181,6 +205,7 @@ static SDispatchResult dispatch_move_to_workspace(std::string value) {
 static SDispatchResult dispatch_changefocus(std::string arg) {
 	auto* hy3 = hy3InstanceForAction();
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 	auto ws = hy3->workspace();
 
 	if (arg == "top") hy3->changeFocus(ws.get(), FocusShift::Top);
@@ -195,6 +220,7 @@ static SDispatchResult dispatch_changefocus(std::string arg) {
 static SDispatchResult dispatch_focustab(std::string value) {
 	auto* hy3 = hy3InstanceForAction();
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 	auto ws = hy3->workspace();
 
 	auto i = 0;
@@ -234,6 +260,7 @@ static SDispatchResult dispatch_focustab(std::string value) {
 static SDispatchResult dispatch_setswallow(std::string arg) {
 	auto* hy3 = hy3InstanceForAction();
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 
 	SetSwallowOption option;
 	if (arg == "true") {
@@ -251,6 +278,7 @@ static SDispatchResult dispatch_setswallow(std::string arg) {
 static SDispatchResult dispatch_killactive(std::string value) {
 	auto* hy3 = hy3InstanceForAction(true);
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 
 	hy3->killFocusedNode(hy3->workspace().get());
 	return SDispatchResult {};
@@ -259,6 +287,7 @@ static SDispatchResult dispatch_killactive(std::string value) {
 static SDispatchResult dispatch_expand(std::string value) {
 	auto* hy3 = hy3InstanceForAction();
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 
 	auto args = CVarList(value);
 
@@ -285,6 +314,7 @@ static SDispatchResult dispatch_expand(std::string value) {
 static SDispatchResult dispatch_locktab(std::string arg) {
 	auto* hy3 = hy3InstanceForAction();
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 
 	auto mode = TabLockMode::Toggle;
 	if (arg == "lock") mode = TabLockMode::Lock;
@@ -297,12 +327,44 @@ static SDispatchResult dispatch_locktab(std::string arg) {
 static SDispatchResult dispatch_equalize(std::string arg) {
 	auto* hy3 = hy3InstanceForAction();
 	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
 
 	bool recursive = (arg == "workspace");
 	hy3->equalize(hy3->workspace().get(), recursive);
 	return SDispatchResult {};
 }
 
+static SDispatchResult dispatch_normalize(std::string arg) {
+	auto* hy3 = hy3InstanceForAction();
+	if (!hy3) return SDispatchResult {};
+	auto transaction = Hy3Layout::Transaction(hy3);
+
+	auto result = hy3->normalize();
+
+	auto summary = std::format(
+	    "removed {} groups, tree depth {} -> {}",
+	    result.removed,
+	    result.depth_before,
+	    result.depth_after
+	);
+
+	if (arg == "notify") {
+		HyprlandAPI::addNotificationV2(
+		    PHANDLE,
+		    {
+		        {"text", "hy3: normalize " + summary},
+		        {"time", (uint64_t) 5000},
+		        {"color", CHyprColor(1.0, 1.0, 1.0, 1.0)},
+		        {"icon", ICON_INFO},
+		    }
+		);
+	}
+
+	// shown by `hyprctl dispatch`, which only prints errors
+	if (result.removed == 0) return {.success = false, .error = "nothing to normalize, " + summary};
+	return SDispatchResult {};
+}
+
 static SDispatchResult dispatch_debug(std::string arg) {
 	auto output = Hy3Layout::debugNodes();
 
@@ -315,6 +377,137 @@ static SDispatchResult dispatch_debug(std::string arg) {
 	return { .success = false, .error = output };
 }
 
+#ifdef HY3_BENCHMARK
+// Deepest chain built by hy3:benchmark. Walks and teardown recurse once per level.
+static const size_t BENCHMARK_MAX_DEPTH = 4096;
+
+// A balanced tree, grouping windows eight at a time, then those groups, until one
+// group is left.
+static UP<Hy3Node> benchmarkWideTree(size_t windows) {
+	std::vector<UP<Hy3Node>> level;
+	for (size_t i = 0; i < windows; i++) {
+		level.push_back(Hy3Node::create(SP<Layout::ITarget>()));
+	}
+
+	do {
+		std::vector<UP<Hy3Node>> next;
+
+		for (size_t i = 0; i < level.size(); i += 8) {
+			auto layout = next.size() % 2 ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH;
+			auto group = Hy3Node::create(layout);
+
+			for (auto j = i; j < std::min(i + 8, level.size()); j++) {
+				group->as_group().insertChild(std::move(level[j]));
+			}
+
+			next.push_back(std::move(group));
+		}
+
+		level = std::move(next);
+	} while (level.size() > 1);
+
+	return std::move(level.front());
+}
+
+// A chain of nested groups, each holding one window and the next group. Built from
+// the bottom up so inserts never walk the ancestors.
+static UP<Hy3Node> benchmarkDeepTree(size_t depth) {
+	UP<Hy3Node> tree;
+
+	for (size_t i = 0; i < depth; i++) {
+		auto group = Hy3Node::create(i % 2 ? Hy3GroupLayout::SplitV : Hy3GroupLayout::SplitH);
+		group->as_group().insertChild(Hy3Node::create(SP<Layout::ITarget>()));
+		if (tree) group->as_group().insertChild(std::move(tree));
+		tree = std::move(group);
+	}
+
+	return tree;
+}
+
+// Nanoseconds per node spent on node type queries over `root`, with and without
+// RTTI. The cost of the walk itself, timed with an empty query, is subtracted.
+static std::string benchmarkTree(const char* name, Hy3Node& root) {
+	using clock = std::chrono::steady_clock;
+	const auto passes = 20;
+
+	struct Timing {
+		double ns; // per node
+		size_t nodes;
+		size_t matched;
+	};
+
+	auto measure = [&](auto&& query) {
+		size_t nodes = 0;
+		size_t matched = 0;
+		auto start = clock::now();
+
+		for (auto pass = 0; pass < passes; pass++) {
+			root.forEachNode([&](Hy3Node& node) {
+				nodes++;
+				matched += query(node);
+			});
+		}
+
+		auto elapsed = std::chrono::duration<double, std::nano>(clock::now() - start).count();
+		return Timing {.ns = elapsed / nodes, .nodes = nodes / passes, .matched = matched / passes};
+	};
+
+	auto walk = measure([](Hy3Node&) { return false; });
+	auto kind = measure([](Hy3Node& node) { return node.is_target(); });
+	auto rtti = measure([](Hy3Node& node) {
+		return dynamic_cast<Hy3TargetNode*>(&node) != nullptr;
+	});
+
+	auto output = std::format(
+	    "{}: {} nodes, {} windows, walk {:.2f} ns/node, is_target +{:.2f} ns/node, "
+	    "dynamic_cast +{:.2f} ns/node",
+	    name,
+	    walk.nodes,
+	    kind.matched,
+	    walk.ns,
+	    kind.ns - walk.ns,
+	    rtti.ns - walk.ns
+	);
+
+	if (kind.matched != rtti.matched) output += " (window counts differ)";
+	return output;
+}
+
+// Time node type queries against the dynamic_cast they replaced, over a wide tree of
+// `arg` windows (default 100000) and a chain of nested groups as deep as allowed.
+static SDispatchResult dispatch_benchmark(std::string arg) {
+	size_t windows = 100000;
+	if (!arg.empty()) {
+		try {
+			windows = std::stoul(arg);
+		} catch (...) {
+			return {.success = false, .error = "invalid window count: " + arg};
+		}
+	}
+
+	if (windows == 0) return {.success = false, .error = "window count must be nonzero"};
+
+	auto wide = benchmarkWideTree(windows);
+	auto deep = benchmarkDeepTree(std::min(windows, BENCHMARK_MAX_DEPTH));
+
+	auto output = benchmarkTree("wide", *wide) + "\n" + benchmarkTree("deep", *deep);
+
+	hy3_log(LOG, "BENCHMARK:\n{}", output);
+
+	HyprlandAPI::addNotificationV2(
+	    PHANDLE,
+	    {
+	        {"text", "hy3: benchmark\n" + output},
+	        {"time", (uint64_t) 10000},
+	        {"color", CHyprColor(1.0, 1.0, 1.0, 1.0)},
+	        {"icon", ICON_INFO},
+	    }
+	);
+
+	return SDispatchResult {};
+}
+#endif
+
 void registerDispatchers() {
 	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:makegroup", dispatch_makegroup);
 	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:changegroup", dispatch_changegroup);
@@ -331,5 +524,9 @@ void registerDispatchers() {
 	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:expand", dispatch_expand);
 	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:locktab", dispatch_locktab);
 	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:equalize", dispatch_equalize);
+	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:normalize", dispatch_normalize);
 	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:debugnodes", dispatch_debug);
+#ifdef HY3_BENCHMARK
+	HyprlandAPI::addDispatcherV2(PHANDLE, "hy3:benchmark", dispatch_benchmark);
+#endif
 }
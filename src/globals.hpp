@@ -1,13 +1,18 @@
 #pragma once
 
+#include <cstdint>
+#include <limits>
 #include <set>
 #include <type_traits>
+#include <unordered_map>
 #include <vector>
 
+#include <hyprland/src/Compositor.hpp>
 #include <hyprland/src/desktop/Workspace.hpp>
 #include <hyprland/src/plugins/PluginAPI.hpp>
 #include <hyprlang.hpp>
 
+#include "DropPreview.hpp"
 #include "Hy3Layout.hpp"
 #include "TabGroup.hpp"
 #include "log.hpp"
@@ -23,10 +28,66 @@ inline std::set<Hy3Layout*> g_hy3Instances;
 inline std::vector<WP<Hy3TabGroup>> g_tabGroups;
 inline std::vector<UP<Hy3TabGroup>> g_destroyingTabGroups;
 
+// Stacking rank of each window, higher is on top, kept in step with
+// g_pCompositor->m_windows without rescanning it. Hyprland only restacks by moving
+// a window to either end of the list, so windows are ranked when mapped, dropped
+// when unmapped, and moved past the current top or bottom rank when restacked.
+struct Hy3ZOrder {
+	static constexpr int64_t UNKNOWN = std::numeric_limits<int64_t>::min();
+
+	// Rank every window by its position in m_windows. Only needed for windows that
+	// were mapped before the plugin was loaded.
+	void seed() {
+		this->ranks.clear();
+		this->top = 0;
+		this->bottom = 1;
+
+		for (auto& window: g_pCompositor->m_windows) {
+			this->ranks[window.get()] = ++this->top;
+		}
+	}
+
+	int64_t rank(const Desktop::View::CWindow* window) const {
+		auto it = this->ranks.find(window);
+		return it == this->ranks.end() ? UNKNOWN : it->second;
+	}
+
+	void raise(const Desktop::View::CWindow* window) {
+		if (this->rank(window) != this->top) this->ranks[window] = ++this->top;
+	}
+
+	void lower(const Desktop::View::CWindow* window) {
+		if (this->rank(window) != this->bottom) this->ranks[window] = --this->bottom;
+	}
+
+	void remove(const Desktop::View::CWindow* window) { this->ranks.erase(window); }
+
+	// Pick up restacks made without an event by checking both ends of m_windows.
+	void sync() {
+		auto& windows = g_pCompositor->m_windows;
+		if (windows.empty()) return;
+
+		this->raise(windows.back().get());
+		if (windows.size() > 1) this->lower(windows.front().get());
+	}
+
+private:
+	std::unordered_map<const Desktop::View::CWindow*, int64_t> ranks;
+	int64_t top = 0;
+	int64_t bottom = 1;
+};
+
+inline Hy3ZOrder g_zOrder;
+
+inline Hy3DropPreview g_dropPreview;
+
 inline CHyprSignalListener g_renderListener;
 inline CHyprSignalListener g_tickListener;
 inline CHyprSignalListener g_windowTitleListener;
 inline CHyprSignalListener g_urgentListener;
+inline CHyprSignalListener g_windowOpenListener;
+inline CHyprSignalListener g_windowCloseListener;
+inline CHyprSignalListener g_windowMoveListener;
 
 inline Hy3Layout* hy3InstanceForWorkspace(PHLWORKSPACE ws) {
 	if (!ws || !ws->m_space || !ws->m_space->algorithm()) return nullptr;
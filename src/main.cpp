@@ -43,6 +43,8 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 	CONF("node_collapse_policy", INT, 2);
 	CONF("group_inset", INT, 10);
 	CONF("tab_first_window", INT, 0);
+	CONF("deferred_layout", INT, 0);
+	CONF("auto_normalize", INT, 0);
 
 	// tabs
 	CONF("tabs:height", INT, 22);
@@ -55,8 +57,11 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 	CONF("tabs:text_font", STRING, "Sans");
 	CONF("tabs:text_height", INT, 8);
 	CONF("tabs:text_padding", INT, 3);
+	CONF("tabs:text_cache_size", INT, 8);
+	CONF("tabs:text_cache_layouts", INT, 256);
 	CONF("tabs:opacity", FLOAT, 1.0);
 	CONF("tabs:blur", INT, 1);
+	CONF("tabs:render_cache", INT, 0);
 	CONF("tabs:col.active", INT, 0x4033ccff);
 	CONF("tabs:col.active.border", INT, 0xee33ccff);
 	CONF("tabs:col.active.text", INT, 0xffffffff);
@@ -83,6 +88,11 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 	CONF("autotile:trigger_width", INT, 0);
 	CONF("autotile:workspaces", STRING, "all");
 
+	// mouse drag
+	CONF("drag:preview", INT, 1);
+	CONF("drag:wrap", INT, 0);
+	CONF("drag:col.preview", INT, 0x4033ccff);
+
 #undef CONF
 
 	HyprlandAPI::addTiledAlgo(PHANDLE, "hy3", &typeid(Hy3Layout), []() -> UP<Layout::ITiledAlgorithm> {
@@ -114,12 +124,24 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 				}
 			}
 			break;
-		case RENDER_POST_WINDOWS: rendering_normally = false; break;
+		case RENDER_POST_WINDOWS:
+			if (rendering_normally) g_dropPreview.addToPass();
+			rendering_normally = false;
+			break;
 		default: break;
 		}
 	});
 
 	g_tickListener = Event::bus()->m_events.tick.listen([]() {
+		g_zOrder.sync();
+
+		// layouts deferred by plugin:hy3:deferred_layout
+		for (auto* hy3: g_hy3Instances) {
+			hy3->flushGeometry();
+		}
+
+		g_dropPreview.tick();
+
 		for (auto& wp: g_tabGroups) {
 			if (auto* tg = wp.get()) tg->tick();
 		}
@@ -143,9 +165,42 @@ APICALL EXPORT PLUGIN_DESCRIPTION_INFO PLUGIN_INIT(HANDLE handle) {
 		if (!hy3) return;
 		auto* node = hy3->getNodeFromWindow(window.get());
 		if (!node) return;
+		node->as<Hy3TargetNode>().refreshUrgent();
 		node->updateTabBarRecursive();
 	});
 
+	g_windowOpenListener = Event::bus()->m_events.window.open.listen([](PHLWINDOW window) {
+		if (!window) return;
+		g_zOrder.raise(window.get());
+
+		if (!window->m_isFloating) return;
+		if (auto* hy3 = hy3InstanceForWorkspace(window->m_workspace)) hy3->trackFloatingWindow(window);
+	});
+
+	g_windowCloseListener = Event::bus()->m_events.window.close.listen([](PHLWINDOW window) {
+		if (!window) return;
+		g_zOrder.remove(window.get());
+
+		for (auto* hy3: g_hy3Instances) {
+			hy3->untrackFloatingWindow(window.get());
+		}
+	});
+
+	g_windowMoveListener = Event::bus()->m_events.window.moveToWorkspace.listen(
+	    [](PHLWINDOW window, PHLWORKSPACE workspace) {
+		    if (!window) return;
+
+		    for (auto* hy3: g_hy3Instances) {
+			    hy3->untrackFloatingWindow(window.get());
+		    }
+
+		    if (!window->m_isFloating) return;
+		    if (auto* hy3 = hy3InstanceForWorkspace(workspace)) hy3->trackFloatingWindow(window);
+	    }
+	);
+
+	g_zOrder.seed();
+
 	registerDispatchers();
 
 	HyprlandAPI::reloadConfig();
@@ -158,7 +213,12 @@ APICALL EXPORT void PLUGIN_EXIT() {
 	g_tickListener.reset();
 	g_windowTitleListener.reset();
 	g_urgentListener.reset();
+	g_windowOpenListener.reset();
+	g_windowCloseListener.reset();
+	g_windowMoveListener.reset();
 
+	g_dropPreview.clear();
 	g_tabGroups.clear();
 	g_destroyingTabGroups.clear();
+	Hy3GlyphAtlas::destroy();
 }
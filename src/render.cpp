@@ -1,4 +1,7 @@
 #include "render.hpp"
+#include <algorithm>
+#include <optional>
+#include <utility>
 
 #include <GLES2/gl2.h>
 #include <hyprland/src/helpers/math/Math.hpp>
@@ -8,25 +11,50 @@
 #include <hyprutils/math/Misc.hpp>
 #include <hyprutils/math/Vector2D.hpp>
 
+#include "TextAtlas.hpp"
 #include "shaders.hpp"
 
 using Hyprutils::Math::CBox;
 using Hyprutils::Math::HYPRUTILS_TRANSFORM_NORMAL;
 
-void Hy3Render::renderTab(
-    const CBox& box,
-    float opacity,
-    bool blur,
-    const CHyprColor& fillColor,
-    const CHyprColor& borderColor,
-    int borderWidth,
-    int radius
-) {
-	static auto& shader = Hy3Shaders::instance()->tab;
+// Size of the framebuffer being drawn to, if not the monitor.
+static std::optional<Vector2D> offscreenSize;
+// Viewport in use before beginOffscreen.
+static GLint savedViewport[4];
+
+void Hy3Render::beginOffscreen(const Vector2D& size) {
+	offscreenSize = size;
+
+	// binding a framebuffer leaves the viewport at the monitor's size
+	glGetIntegerv(GL_VIEWPORT, savedViewport);
+	glViewport(0, 0, size.x, size.y);
+}
+
+void Hy3Render::endOffscreen() {
+	offscreenSize.reset();
+	glViewport(savedViewport[0], savedViewport[1], savedViewport[2], savedViewport[3]);
+}
+
+// Bind `program` and set the projection and monitor size uniforms shared by hy3 shaders.
+static void useProgram(const SP<CShader>& program, GLint proj, GLint monitorSizeLoc) {
 	auto& rdata = g_pHyprOpenGL->m_renderData;
 
-	auto rbox = box;
-	rdata.renderModif.applyToBox(rbox);
+	if (offscreenSize) {
+		// map 0..1 to clip space directly, leaving row 0 of the framebuffer at the top
+		// like any other texture
+		g_pHyprOpenGL->useShader(program);
+
+#ifndef GLES2
+		const float ortho[] = {2, 0, -1, 0, 2, -1, 0, 0, 1};
+		glUniformMatrix3fv(proj, 1, GL_TRUE, ortho);
+#else
+		const float ortho[] = {2, 0, 0, 0, 2, 0, -1, -1, 1};
+		glUniformMatrix3fv(proj, 1, GL_FALSE, ortho);
+#endif
+
+		glUniform2f(monitorSizeLoc, offscreenSize->x, offscreenSize->y);
+		return;
+	}
 
 	const auto& monitorSize = rdata.pMonitor->m_transformedSize;
 	auto monitorBox = CBox {Vector2D(), monitorSize};
@@ -36,15 +64,59 @@ void Hy3Render::renderTab(
 
 	auto glMatrix = rdata.projection.copy().multiply(matrix);
 
-	g_pHyprOpenGL->useShader(shader.program);
+	g_pHyprOpenGL->useShader(program);
 
 #ifndef GLES2
-	glUniformMatrix3fv(shader.proj, 1, GL_TRUE, glMatrix.getMatrix().data());
+	glUniformMatrix3fv(proj, 1, GL_TRUE, glMatrix.getMatrix().data());
 #else
 	glMatrix.transpose();
-	glUniformMatrix3fv(shader.proj, 1, GL_FALSE, glMatrix.getMatrix().data());
+	glUniformMatrix3fv(proj, 1, GL_FALSE, glMatrix.getMatrix().data());
 #endif
 
+	glUniform2f(monitorSizeLoc, monitorSize.x, monitorSize.y);
+}
+
+void Hy3Render::renderTabs(const std::vector<Hy3TabInstance>& tabs, bool blur) {
+	static auto& shader = Hy3Shaders::instance()->tab;
+	static std::vector<float> instances;
+	auto& rdata = g_pHyprOpenGL->m_renderData;
+
+	if (tabs.empty()) return;
+
+	instances.clear();
+
+	for (auto& tab: tabs) {
+		auto rbox = tab.box;
+		if (!offscreenSize) rdata.renderModif.applyToBox(rbox);
+
+		auto& fill = tab.fill_color;
+		auto& border = tab.border_color;
+
+		// colors are premultiplied
+		instances.insert(
+		    instances.end(),
+		    {
+		        static_cast<float>(rbox.x),
+		        static_cast<float>(rbox.y),
+		        static_cast<float>(rbox.w),
+		        static_cast<float>(rbox.h),
+		        static_cast<float>(fill.r * fill.a),
+		        static_cast<float>(fill.g * fill.a),
+		        static_cast<float>(fill.b * fill.a),
+		        static_cast<float>(fill.a),
+		        static_cast<float>(border.r * border.a),
+		        static_cast<float>(border.g * border.a),
+		        static_cast<float>(border.b * border.a),
+		        static_cast<float>(border.a),
+		        tab.opacity,
+		        static_cast<float>(tab.border_width),
+		        static_cast<float>(tab.radius),
+		    }
+		);
+	}
+
+	useProgram(shader.program, shader.proj, shader.monitorSize);
+
 	WP<CTexture> blurTex;
 
 	if (blur) {
@@ -60,37 +132,130 @@ void Hy3Render::renderTab(
 
 	glUniform1i(shader.applyBlur, blur);
 
-	// premultiplied
-	glUniform4f(
-	    shader.fillColor,
-	    fillColor.r * fillColor.a,
-	    fillColor.g * fillColor.a,
-	    fillColor.b * fillColor.a,
-	    fillColor.a
+	glBindVertexArray(shader.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, shader.instance_vbo);
+	glBufferData(
+	    GL_ARRAY_BUFFER,
+	    instances.size() * sizeof(float),
+	    instances.data(),
+	    GL_STREAM_DRAW
 	);
 
-	if (borderWidth != 0) {
-		glUniform4f(
-		    shader.borderColor,
-		    borderColor.r * borderColor.a,
-		    borderColor.g * borderColor.a,
-		    borderColor.b * borderColor.a,
-		    borderColor.a
-		);
-	}
-
-	glUniform2f(shader.monitorSize, monitorSize.x, monitorSize.y);
-	glUniform2f(shader.pixelOffset, rbox.x, rbox.y);
-	glUniform2f(shader.pixelSize, rbox.w, rbox.h);
-	glUniform1f(shader.opacity, opacity);
-	glUniform1f(shader.outerRadius, radius);
-	glUniform1f(shader.borderWidth, borderWidth);
+	glDrawArraysInstanced(GL_TRIANGLE_STRIP, 0, 4, tabs.size());
 
-	glBindVertexArray(shader.program->getUniformLocation(SHADER_SHADER_VAO));
-	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
 	glBindVertexArray(0);
 
 	if (blur) {
 		glBindTexture(blurTex->m_target, 0);
 	}
 }
+
+void Hy3Render::renderTexts(const std::vector<Hy3TextInstance>& texts) {
+	static auto& shader = Hy3Shaders::instance()->text;
+	static std::vector<float> vertices;
+	auto& rdata = g_pHyprOpenGL->m_renderData;
+
+	if (texts.empty()) return;
+	auto& atlas = Hy3GlyphAtlas::instance();
+
+	// Uploads made after the atlas was emptied may retire a layout's pages,
+	// check which layouts are drawable only once they have been flushed.
+	atlas.flushUploads();
+
+	// atlas generation and page index
+	using Page = std::pair<uint64_t, size_t>;
+	std::optional<Page> page;
+
+	for (auto& text: texts) {
+		if (!atlas.drawable(*text.layout)) continue;
+
+		for (auto& glyph: text.layout->glyphs) {
+			auto glyph_page = Page(text.layout->generation, glyph.page);
+			page = page ? std::min(*page, glyph_page) : glyph_page;
+		}
+	}
+
+	if (!page) return;
+
+	useProgram(shader.program, shader.proj, shader.monitorSize);
+
+	glUniform1i(shader.tex, 0);
+	glActiveTexture(GL_TEXTURE0);
+
+	glBindVertexArray(shader.vao);
+	glBindBuffer(GL_ARRAY_BUFFER, shader.vbo);
+
+	// nearly always a single page, draw each page used in one call
+	while (page) {
+		auto next_page = std::optional<Page>();
+		vertices.clear();
+
+		for (auto& text: texts) {
+			auto& layout = *text.layout;
+			if (layout.glyphs.empty() || !atlas.drawable(layout)) continue;
+
+			// apply render modifications to the text as a whole, then place glyphs inside it
+			auto bounds = CBox {text.origin, Vector2D(layout.logical_width, layout.logical_height)};
+			auto rbounds = bounds;
+			if (!offscreenSize) rdata.renderModif.applyToBox(rbounds);
+			auto scale_x = bounds.w > 0 ? rbounds.w / bounds.w : 1.0;
+			auto scale_y = bounds.h > 0 ? rbounds.h / bounds.h : 1.0;
+
+			// premultiplied, with opacity applied
+			auto alpha = text.color.a * text.opacity;
+			auto r = static_cast<float>(text.color.r * alpha);
+			auto g = static_cast<float>(text.color.g * alpha);
+			auto b = static_cast<float>(text.color.b * alpha);
+			auto a = static_cast<float>(alpha);
+
+			for (auto& glyph: layout.glyphs) {
+				auto glyph_page = Page(layout.generation, glyph.page);
+
+				if (glyph_page != *page) {
+					if (glyph_page > *page && (!next_page || glyph_page < *next_page)) {
+						next_page = glyph_page;
+					}
+
+					continue;
+				}
+
+				auto x0 = static_cast<float>(rbounds.x + glyph.x * scale_x);
+				auto y0 = static_cast<float>(rbounds.y + glyph.y * scale_y);
+				auto x1 = static_cast<float>(x0 + glyph.w * scale_x);
+				auto y1 = static_cast<float>(y0 + glyph.h * scale_y);
+
+				auto c = glyph.color ? 1.0f : 0.0f;
+
+				vertices.insert(
+				    vertices.end(),
+				    {
+				        x0, y0, glyph.u0, glyph.v0, r, g, b, a, c, // top left
+				        x1, y0, glyph.u1, glyph.v0, r, g, b, a, c, // top right
+				        x0, y1, glyph.u0, glyph.v1, r, g, b, a, c, // bottom left
+				        x1, y0, glyph.u1, glyph.v0, r, g, b, a, c, // top right
+				        x1, y1, glyph.u1, glyph.v1, r, g, b, a, c, // bottom right
+				        x0, y1, glyph.u0, glyph.v1, r, g, b, a, c, // bottom left
+				    }
+				);
+			}
+		}
+
+		if (!vertices.empty()) {
+			glBindTexture(GL_TEXTURE_2D, atlas.page(page->first, page->second)->m_texID);
+			glBufferData(
+			    GL_ARRAY_BUFFER,
+			    vertices.size() * sizeof(float),
+			    vertices.data(),
+			    GL_STREAM_DRAW
+			);
+			glDrawArrays(GL_TRIANGLES, 0, vertices.size() / 9);
+		}
+
+		page = next_page;
+	}
+
+	glBindTexture(GL_TEXTURE_2D, 0);
+	glBindBuffer(GL_ARRAY_BUFFER, 0);
+	glBindVertexArray(0);
+}
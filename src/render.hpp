@@ -1,16 +1,50 @@
 #pragma once
+#include <vector>
+
 #include <hyprland/src/helpers/Color.hpp>
 #include <hyprutils/math/Box.hpp>
+#include <hyprutils/math/Vector2D.hpp>
+
+#include "TextAtlas.hpp"
+
+struct Hy3TabInstance {
+	Hyprutils::Math::CBox box;
+	CHyprColor fill_color;
+	CHyprColor border_color;
+	float opacity;
+	int border_width;
+	int radius;
+};
+
+struct Hy3TextInstance {
+	SP<Hy3TextLayout> layout;
+	Hyprutils::Math::Vector2D origin; // top left of the layout's logical extents
+	CHyprColor color;
+	float opacity;
+};
+
+// Everything drawn for one tab bar, collected before any GL calls are made.
+struct Hy3TabBatch {
+	std::vector<Hy3TabInstance> tabs;
+	std::vector<Hy3TextInstance> texts;
+
+	void clear() {
+		this->tabs.clear();
+		this->texts.clear();
+	}
+};
 
 class Hy3Render {
 public:
-	static void renderTab(
-	    const Hyprutils::Math::CBox& box,
-	    float opacity,
-	    bool blur,
-	    const CHyprColor& fillColor,
-	    const CHyprColor& borderColor,
-	    int borderWidth,
-	    int radius
-	);
+	// Draw every tab background in a single instanced call, in order.
+	static void renderTabs(const std::vector<Hy3TabInstance>& tabs, bool blur);
+
+	// Draw every title from the glyph atlas, in one call per atlas page used.
+	static void renderTexts(const std::vector<Hy3TextInstance>& texts);
+
+	// Draw into the bound framebuffer of `size` pixels instead of the monitor, with
+	// (0, 0) at its top left. Render modifications are not applied. Sets the
+	// viewport to `size` until endOffscreen.
+	static void beginOffscreen(const Hyprutils::Math::Vector2D& size);
+	static void endOffscreen();
 };
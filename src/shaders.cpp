@@ -9,6 +9,22 @@
 
 #include "shader_content.hpp"
 
+// Point `name` at `components` floats of the bound buffer, `offset` floats into each record.
+static void vertexAttrib(GLuint program, const char* name, int components, int stride, int offset) {
+	auto location = glGetAttribLocation(program, name);
+	if (location < 0) return;
+
+	glEnableVertexAttribArray(location);
+	glVertexAttribPointer(
+	    location,
+	    components,
+	    GL_FLOAT,
+	    GL_FALSE,
+	    stride * sizeof(float),
+	    reinterpret_cast<void*>(offset * sizeof(float))
+	);
+}
+
 Hy3Shaders::Hy3Shaders() {
 	{
 		auto& s = this->tab;
@@ -19,15 +35,60 @@ Hy3Shaders::Hy3Shaders() {
 		auto program = s.program->program();
 		s.proj = glGetUniformLocation(program, "proj");
 		s.monitorSize = glGetUniformLocation(program, "monitorSize");
-		s.pixelOffset = glGetUniformLocation(program, "pixelOffset");
-		s.pixelSize = glGetUniformLocation(program, "pixelSize");
 		s.applyBlur = glGetUniformLocation(program, "applyBlur");
 		s.blurTex = glGetUniformLocation(program, "blurTex");
-		s.opacity = glGetUniformLocation(program, "opacity");
-		s.fillColor = glGetUniformLocation(program, "fillColor");
-		s.borderColor = glGetUniformLocation(program, "borderColor");
-		s.borderWidth = glGetUniformLocation(program, "borderWidth");
-		s.outerRadius = glGetUniformLocation(program, "outerRadius");
+
+		glGenVertexArrays(1, &s.vao);
+		glBindVertexArray(s.vao);
+
+		// unit quad shared by every tab
+		const float quad[] = {0, 0, 1, 0, 0, 1, 1, 1};
+		glGenBuffers(1, &s.quad_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, s.quad_vbo);
+		glBufferData(GL_ARRAY_BUFFER, sizeof(quad), quad, GL_STATIC_DRAW);
+		vertexAttrib(program, "pos", 2, 2, 0);
+
+		// x, y, w, h, fill rgba, border rgba, opacity, border width, radius
+		glGenBuffers(1, &s.instance_vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, s.instance_vbo);
+		vertexAttrib(program, "rect", 4, 15, 0);
+		vertexAttrib(program, "fillColor", 4, 15, 4);
+		vertexAttrib(program, "borderColor", 4, 15, 8);
+		vertexAttrib(program, "params", 3, 15, 12);
+
+		for (auto* name: {"rect", "fillColor", "borderColor", "params"}) {
+			auto location = glGetAttribLocation(program, name);
+			if (location >= 0) glVertexAttribDivisor(location, 1);
+		}
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+	}
+
+	{
+		auto& s = this->text;
+		s.program = makeShared<CShader>();
+		if (!s.program->createProgram(std::string(SHADER_TEXT_VERT), std::string(SHADER_TEXT_FRAG))) {
+			throw std::runtime_error("hy3 text shader compilation fails");
+		}
+		auto program = s.program->program();
+		s.proj = glGetUniformLocation(program, "proj");
+		s.monitorSize = glGetUniformLocation(program, "monitorSize");
+		s.tex = glGetUniformLocation(program, "tex");
+
+		glGenVertexArrays(1, &s.vao);
+		glBindVertexArray(s.vao);
+		glGenBuffers(1, &s.vbo);
+		glBindBuffer(GL_ARRAY_BUFFER, s.vbo);
+
+		// x, y, u, v, rgba, colored
+		vertexAttrib(program, "pos", 2, 9, 0);
+		vertexAttrib(program, "texcoord", 2, 9, 2);
+		vertexAttrib(program, "color", 4, 9, 4);
+		vertexAttrib(program, "colored", 1, 9, 8);
+
+		glBindVertexArray(0);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
 	}
 }
 
@@ -10,17 +10,24 @@ public:
 		SP<CShader> program;
 		GLint proj;
 		GLint monitorSize;
-		GLint pixelOffset;
-		GLint pixelSize;
 		GLint applyBlur;
 		GLint blurTex;
-		GLint opacity;
-		GLint fillColor;
-		GLint borderColor;
-		GLint borderWidth;
-		GLint outerRadius;
+		// one instance per tab, see Hy3Render::renderTabs
+		GLuint vao;
+		GLuint quad_vbo;
+		GLuint instance_vbo;
 	} tab;
 
+	struct {
+		SP<CShader> program;
+		GLint proj;
+		GLint monitorSize;
+		GLint tex;
+		// glyph quads are streamed into this buffer, see Hy3Render::renderTexts
+		GLuint vao;
+		GLuint vbo;
+	} text;
+
 	static Hy3Shaders* instance();
 
 private:
@@ -1,20 +1,21 @@
 precision highp float;
 
-uniform highp vec2 pixelSize;
-uniform float opacity;
-uniform highp vec4 fillColor;
-uniform highp vec4 borderColor;
-uniform float outerRadius;
-uniform float borderWidth;
-
 uniform bool applyBlur;
 uniform sampler2D blurTex;
 
 varying highp vec2 pixCoord;
 varying highp vec2 monitorTexCoord;
+varying highp vec2 pixelSize;
+varying highp vec4 v_fillColor;
+varying highp vec4 v_borderColor;
+varying highp vec3 v_params;
 
 void main() {
-	float opacityMul = opacity;
+	highp vec4 fillColor = v_fillColor;
+	highp vec4 borderColor = v_borderColor;
+	float opacityMul = v_params.x;
+	float borderWidth = v_params.y;
+	float outerRadius = v_params.z;
 	highp vec2 cornerDist = min(pixCoord, pixelSize - pixCoord);
 
 	gl_FragColor = fillColor;
@@ -1,15 +1,28 @@
 attribute highp vec2 pos;
 
+// per tab, see Hy3Render::renderTabs
+attribute highp vec4 rect;
+attribute highp vec4 fillColor;
+attribute highp vec4 borderColor;
+attribute highp vec3 params; // opacity, border width, outer radius
+
 uniform mat3 proj;
-uniform highp vec2 pixelOffset;
-uniform highp vec2 pixelSize;
 uniform highp vec2 monitorSize;
 
 varying highp vec2 pixCoord;
 varying highp vec2 monitorTexCoord;
+varying highp vec2 pixelSize;
+varying highp vec4 v_fillColor;
+varying highp vec4 v_borderColor;
+varying highp vec3 v_params;
 
 void main() {
+	pixelSize = rect.zw;
+	v_fillColor = fillColor;
+	v_borderColor = borderColor;
+	v_params = params;
+
 	pixCoord = pos * pixelSize;
-	monitorTexCoord = (pixelOffset + pixCoord) / monitorSize;
+	monitorTexCoord = (rect.xy + pixCoord) / monitorSize;
 	gl_Position = vec4(proj * vec3(monitorTexCoord, 1.0), 1.0);
 }
@@ -0,0 +1,14 @@
+precision highp float;
+
+uniform sampler2D tex;
+
+varying highp vec2 v_texcoord;
+varying highp vec4 v_color;
+varying highp float v_colored;
+
+void main() {
+	vec4 texel = texture2D(tex, v_texcoord);
+
+	// color glyphs keep their own premultiplied colors and only take the text's alpha
+	gl_FragColor = mix(v_color * texel.a, texel * v_color.a, v_colored);
+}
@@ -0,0 +1,18 @@
+attribute highp vec2 pos;
+attribute highp vec2 texcoord;
+attribute highp vec4 color; // premultiplied, opacity applied
+attribute highp float colored; // 1 for glyphs on an RGBA page
+
+uniform mat3 proj;
+uniform highp vec2 monitorSize;
+
+varying highp vec2 v_texcoord;
+varying highp vec4 v_color;
+varying highp float v_colored;
+
+void main() {
+	v_texcoord = texcoord;
+	v_color = color;
+	v_colored = colored;
+	gl_Position = vec4(proj * vec3(pos / monitorSize, 1.0), 1.0);
+}